@@ -0,0 +1,50 @@
+/*
+ * ENTE-TCP: Entropy-Enhanced TCP Congestion Control
+ * Generic netlink classification events
+ *
+ * Family ENTE_TCP_GENL_NAME sends ENTE_TCP_CMD_STATE_CHANGE to multicast
+ * group ENTE_TCP_GENL_MCGRP_EVENTS each time a flow moves between the
+ * neutral, noise and congestion states. Events are rate-limited per flow
+ * and go to the flow's network namespace only.
+ *
+ * Licensed under GPL v2
+ */
+
+#ifndef _ENTE_TCP_GENL_H
+#define _ENTE_TCP_GENL_H
+
+#define ENTE_TCP_GENL_NAME "ente_tcp"
+#define ENTE_TCP_GENL_VERSION 1
+#define ENTE_TCP_GENL_MCGRP_EVENTS "events"
+
+enum {
+	ENTE_TCP_CMD_UNSPEC,
+	ENTE_TCP_CMD_STATE_CHANGE,   /* Kernel -> user, multicast only */
+	__ENTE_TCP_CMD_MAX
+};
+#define ENTE_TCP_CMD_MAX (__ENTE_TCP_CMD_MAX - 1)
+
+enum {
+	ENTE_TCP_ATTR_UNSPEC,
+	ENTE_TCP_ATTR_PAD,
+	ENTE_TCP_ATTR_FAMILY,        /* u8: AF_INET or AF_INET6 */
+	ENTE_TCP_ATTR_SADDR,         /* 4 or 16 bytes, network order */
+	ENTE_TCP_ATTR_DADDR,         /* 4 or 16 bytes, network order */
+	ENTE_TCP_ATTR_SPORT,         /* u16, host order */
+	ENTE_TCP_ATTR_DPORT,         /* u16, host order */
+	ENTE_TCP_ATTR_CGROUP,        /* u64: cgroup v2 id of the socket */
+	ENTE_TCP_ATTR_OLD_STATE,     /* u8: 0 neutral, 1 noise, 2 congestion */
+	ENTE_TCP_ATTR_NEW_STATE,     /* u8: same values */
+	ENTE_TCP_ATTR_ENTROPY,       /* u16: Shannon entropy (0-1000) */
+	ENTE_TCP_ATTR_SRTT_US,       /* u32: smoothed RTT */
+	ENTE_TCP_ATTR_CWND,          /* u32: cwnd in packets */
+	/* Flows with extended state only */
+	ENTE_TCP_ATTR_HISTORY,       /* u64: last 32 states, 2 bits each, newest low */
+	ENTE_TCP_ATTR_NEUTRAL_COUNT, /* u32: entropy updates classified neutral */
+	ENTE_TCP_ATTR_NOISE_COUNT,   /* u32: ... noise */
+	ENTE_TCP_ATTR_CONGESTION_COUNT, /* u32: ... congestion */
+	__ENTE_TCP_ATTR_MAX
+};
+#define ENTE_TCP_ATTR_MAX (__ENTE_TCP_ATTR_MAX - 1)
+
+#endif /* _ENTE_TCP_GENL_H */
@@ -21,61 +21,716 @@
  */
 
 #include <linux/module.h>
+#include <linux/version.h>
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/tcp.h>
 #include <linux/inet_diag.h>
 #include <net/tcp.h>
 #include <linux/slab.h>
+#include <linux/jhash.h>
+#include <linux/random.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
+#include <linux/inetdevice.h>
+#include <net/ipv6.h>
+#include <net/net_namespace.h>
+#include <net/netns/generic.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
+#include <linux/jump_label.h>
+#include <linux/timex.h>
+#include <linux/relay.h>
+#include <linux/mutex.h>
+#include <linux/reciprocal_div.h>
+#include <linux/cgroup.h>
+#include <net/genetlink.h>
+
+#include "ente_tcp_trace.h"
+#include "ente_tcp_genl.h"
 
 #define ENTE_TCP_VERSION "1.0"
 
 /* Configuration parameters */
 #define ENTROPY_WINDOW_SIZE 16      /* RTT samples for entropy calculation */
 #define ENTROPY_CALC_INTERVAL 8     /* Calculate entropy every N packets */
+#define ENTROPY_MIN_SAMPLES 8       /* Samples needed for a reliable entropy */
 #define HISTOGRAM_BINS 16           /* Number of bins for entropy calculation */
 
-/* Thresholds (scaled by 1000 for integer math) */
-#define HIGH_ENTROPY_THRESHOLD 700  /* 0.7 - above this is noise */
-#define LOW_ENTROPY_THRESHOLD 400   /* 0.4 - below this is congestion */
+/* Thresholds (scaled by 1000 for integer math). srtt moves slowly and is
+ * kept in ms, so 16 samples rarely span many bins: random jitter scores
+ * 0.4-0.9, a standing or slowly growing queue 0-0.4.
+ */
+#define HIGH_ENTROPY_THRESHOLD 500  /* 0.5 - above this is noise */
+#define LOW_ENTROPY_THRESHOLD 300   /* 0.3 - below this is congestion */
+
+/* Loss-gap thresholds: raw gaps spread wider than smoothed RTT */
+#define LOSS_GAP_HIGH_ENTROPY 600   /* Memoryless loss scores 0.6-0.8 */
+#define LOSS_GAP_LOW_ENTROPY 450    /* Overflow bursts score 0.3-0.45 */
 
 /* Aggressiveness factors (scaled by 1000) */
 #define NOISE_AGGRESSION 1500       /* 1.5x more aggressive on noise */
 #define CONGESTION_CONSERVE 500     /* 0.5x more conservative on congestion */
 
+/* Periodic RTT (cellular TTI/DRX scheduling), normalised autocorrelation x1000 */
+#define PERIODIC_SLOT_SHIFT 9       /* Raw RTT binned in 512 us slots */
+#define PERIODIC_SLOTS 160          /* ~82 ms: periods of 1-41 ms */
+#define PERIODIC_RECHECK 40         /* New slots (~20 ms) between checks */
+#define PERIODIC_MIN_SWING_US 100   /* Standard deviation below this is flat */
+#define PERIODIC_TROUGH 300         /* Anti-correlation half a period out */
+#define PERIODIC_PEAK 400           /* Correlation again a full period out */
+
+/* Route change / handover detection: two-sided CUSUM on srtt */
+#define CP_MEAN_SHIFT 4             /* Reference mean EWMA gain 1/16 */
+#define CP_SLACK_SHIFT 3            /* Drift allowed per update: mean / 8 */
+#define CP_SLACK_MIN_US 1000        /* ...but at least 1 ms */
+#define CP_SHIFT_ROUNDS 4           /* Rounds a rise must hold to count */
+
+/* Long-RTT growth scaling (TCP Hybla): rho = RTT / RTT0 */
+#define HYBLA_RTT0_MS 25            /* Reference RTT, same as Hybla */
+#define HYBLA_RHO_MAX 16            /* Cap: 256x Reno's increase from 400 ms */
+
+/* Entropy-aware slow start exit (HyStart++ style delay detection) */
+#define HYSTART_MIN_SAMPLES 8       /* RTT samples per round before deciding */
+#define HYSTART_DELAY_MIN 4000U     /* Delay increase threshold bounds (us) */
+#define HYSTART_DELAY_MAX 16000U
+
+/* Path knowledge aging */
+#define MIN_RTT_WIN_SEC 10          /* min_rtt filter window (seconds) */
+#define MIN_RTT_PROBE_ROUNDS 2      /* On expiry: finish this round, measure the next */
+#define CONFIDENCE_MAX 3            /* Idle restarts a classification survives */
+
+/* Spurious-loss rate: share of loss episodes later undone (DSACK, F-RTO) */
+#define SPURIOUS_WINDOW 16          /* Episodes before both counts are halved */
+#define SPURIOUS_MIN_EPISODES 4     /* Episodes needed before the rate counts */
+
+/* Pacing gains by phase and classification (percent of cwnd/srtt) */
+#define PACING_SS_GAIN 200          /* Slow start, same as tcp_pacing_ss_ratio */
+#define PACING_SS_CONGESTION_GAIN 150 /* Slow start on a congested path */
+#define PACING_NEUTRAL_GAIN 120     /* Same as tcp_pacing_ca_ratio */
+#define PACING_NOISE_GAIN 110       /* Smooth out aggressive noise-mode growth */
+#define PACING_CONGESTION_GAIN 100  /* Do not add to a standing queue */
+
+/* Delivery rate (bottleneck bandwidth) estimate from rate samples */
+#define BW_SCALE 24                 /* Bandwidth in packets/us << BW_SCALE */
+#define BW_UNIT (1 << BW_SCALE)
+#define BW_FILTER_ROUNDS 5          /* Max filter sub-window; window is 5-10 rounds */
+
+/* Model-based mode (ente_tcp_bdp): cwnd target = gain x BDP (percent) */
+#define BDP_NOISE_GAIN 250          /* Noise: keep extra data in flight */
+#define BDP_NEUTRAL_GAIN 200        /* Same cwnd gain as BBR */
+#define BDP_CONGESTION_GAIN 125     /* Congestion: stay close to the BDP */
+#define BDP_MIN_CWND 4              /* Floor for the target */
+#define BDP_PROBE_GAIN 50           /* While min_rtt is re-measured: drain the queue */
+
+/* ECN: CE-marked fraction per round, as in DCTCP */
+#define ECN_ALPHA_SHIFT 4           /* EWMA gain g = 1/16 */
+#define ECN_ALPHA_MAX 1024          /* alpha = 1.0 */
+#define ECN_ALPHA_CLEAN 16          /* Below this (~1.5%) a marking path is clean */
+
+/* L4S (ente_tcp_l4s): scalable response, as in DCTCP/Prague */
+#define L4S_ALPHA_INIT ECN_ALPHA_MAX /* First marks halve cwnd until alpha converges */
+
 /* CWND reduction factors */
 #define NOISE_REDUCTION_FACTOR 3    /* Reduce to 2/3 on noise */
 #define CONGESTION_REDUCTION_FACTOR 2 /* Reduce to 1/2 on congestion */
 
+/* Extended state for long-lived flows (allocated from a slab cache) */
+#define EXT_WINDOW_SIZE 64          /* RTT samples in the extended window */
+#define EXT_SCALES 3                /* Entropy scales: 16, 32, 64 samples */
+#define EXT_DECISION_BITS 2         /* Bits per entry in decision history */
+#define LOSS_GAP_WINDOW 16          /* Loss inter-arrival gaps kept per flow */
+
+/* Extended state allocation policy (see ente_tcp_ext_try_alloc) */
+static bool ext_state __read_mostly = true;
+static unsigned int ext_min_rounds __read_mostly = 16;
+static unsigned int ext_min_bytes __read_mostly = 1U << 20;
+
+module_param(ext_state, bool, 0644);
+MODULE_PARM_DESC(ext_state, "Allocate extended state for long-lived flows");
+module_param(ext_min_rounds, uint, 0644);
+MODULE_PARM_DESC(ext_min_rounds, "Round trips before a flow gets extended state");
+module_param(ext_min_bytes, uint, 0644);
+MODULE_PARM_DESC(ext_min_bytes, "Bytes acked before a flow gets extended state");
+
+/* Short-flow fast path: plain Reno until a flow leaves initial slow start
+ * or has this many bytes acked (0 = track every flow from the start)
+ */
+static unsigned int fastpath_bytes __read_mostly = 64 * 1024;
+
+module_param(fastpath_bytes, uint, 0644);
+MODULE_PARM_DESC(fastpath_bytes, "Bytes acked in slow start before entropy tracking starts");
+
+/* Slow start exit on delay increase, unless the path is classified noisy */
+static bool hystart __read_mostly = true;
+static unsigned int hystart_low_window __read_mostly = 16;
+
+module_param(hystart, bool, 0644);
+MODULE_PARM_DESC(hystart, "Leave slow start early on delay increase with low entropy");
+module_param(hystart_low_window, uint, 0644);
+MODULE_PARM_DESC(hystart_low_window, "Lower bound cwnd for slow start exit");
+
+/* Ask for TCP internal pacing when no fq qdisc is installed */
+static bool pacing __read_mostly = true;
+
+module_param(pacing, bool, 0644);
+MODULE_PARM_DESC(pacing, "Enable TCP internal pacing for ENTE-TCP flows");
+
+/* Noise-mode growth stops at this percentage of the BDP (0 = no cap) */
+static unsigned int noise_bdp_cap __read_mostly = 200;
+
+module_param(noise_bdp_cap, uint, 0644);
+MODULE_PARM_DESC(noise_bdp_cap, "Cap on noise-mode cwnd growth, percent of BDP (0 = off)");
+
+/* Fast recoveries caused by reordering get the minimal (noise) reduction */
+static bool reorder_tolerant __read_mostly = true;
+
+module_param(reorder_tolerant, bool, 0644);
+MODULE_PARM_DESC(reorder_tolerant, "Minimise the reduction for reordering-induced recoveries");
+
+/* Periodic RTT is link scheduling, neither congestion nor random noise */
+static bool periodicity __read_mostly = true;
+
+module_param(periodicity, bool, 0644);
+MODULE_PARM_DESC(periodicity, "Detect periodic RTT (cellular scheduling) and treat it as link behaviour");
+
+/* Abrupt RTT level shifts (route change, handover) reset the path model */
+static bool change_detect __read_mostly = true;
+static bool change_reprobe __read_mostly = true;
+
+module_param(change_detect, bool, 0644);
+MODULE_PARM_DESC(change_detect, "Detect RTT level shifts (route change, handover) and reset the path baseline");
+module_param(change_reprobe, bool, 0644);
+MODULE_PARM_DESC(change_reprobe, "After a detected path change, slow start for up to one round to re-probe bandwidth");
+
+/* Per-ACK trace export (debugfs ente_tcp/trace<cpu>) */
+static unsigned int trace_sample __read_mostly = 64;
+static unsigned int trace_subbuf_size __read_mostly = 256 * 1024;
+static unsigned int trace_n_subbufs __read_mostly = 8;
+
+module_param(trace_sample, uint, 0644);
+MODULE_PARM_DESC(trace_sample, "Trace one in N flows, selected by flow hash (0 or 1 = all)");
+module_param(trace_subbuf_size, uint, 0444);
+MODULE_PARM_DESC(trace_subbuf_size, "Trace relay sub-buffer size in bytes");
+module_param(trace_n_subbufs, uint, 0444);
+MODULE_PARM_DESC(trace_n_subbufs, "Trace relay sub-buffers per CPU");
+
+/* Classification change events (generic netlink, see ente_tcp_genl.h) */
+static unsigned int event_interval_ms __read_mostly = 100;
+static unsigned short event_port __read_mostly;
+static unsigned long long event_cgroup __read_mostly;
+
+module_param(event_interval_ms, uint, 0644);
+MODULE_PARM_DESC(event_interval_ms, "Minimum time between events for one flow (ms)");
+module_param(event_port, ushort, 0644);
+MODULE_PARM_DESC(event_port, "Only send events for flows with this local or remote port (0 = all)");
+module_param(event_cgroup, ullong, 0644);
+MODULE_PARM_DESC(event_cgroup, "Only send events for flows in this cgroup v2 id or below it (0 = all)");
+
+/* Per-destination warm-start cache (per network namespace) */
+#define CACHE_HASH_BITS 8           /* 256 buckets per netns */
+
+static unsigned int cache_size __read_mostly = 1024;
+static unsigned int cache_ttl __read_mostly = 600;
+static unsigned int cache_prefix4 __read_mostly = 24;
+static unsigned int cache_prefix6 __read_mostly = 64;
+
+module_param(cache_size, uint, 0644);
+MODULE_PARM_DESC(cache_size, "Max warm-start cache entries per netns (0 = disabled)");
+module_param(cache_ttl, uint, 0644);
+MODULE_PARM_DESC(cache_ttl, "Seconds a warm-start cache entry stays valid");
+module_param(cache_prefix4, uint, 0444);
+MODULE_PARM_DESC(cache_prefix4, "IPv4 destination prefix length for the cache key");
+module_param(cache_prefix6, uint, 0444);
+MODULE_PARM_DESC(cache_prefix6, "IPv6 destination prefix length for the cache key");
+
+/* Network state classes (also the decision history encoding) */
+enum ente_tcp_state {
+	ENTE_STATE_NEUTRAL = 0,     /* Medium entropy: standard Reno */
+	ENTE_STATE_NOISE = 1,       /* High entropy: random noise */
+	ENTE_STATE_CONGESTION = 2,  /* Low entropy: real congestion */
+};
+
+/* RTT level shifts found by ente_tcp_path_changed() */
+enum ente_tcp_shift {
+	ENTE_SHIFT_NONE,
+	ENTE_SHIFT_UP,              /* Held for CP_SHIFT_ROUNDS: longer path */
+	ENTE_SHIFT_DOWN,            /* Shorter path (or a queue gone) */
+};
+
+/* Registered variants; a compile-time constant in each hot path */
+enum ente_tcp_mode {
+	ENTE_MODE_RENO = 0,         /* ente_tcp: entropy-modulated Reno */
+	ENTE_MODE_BDP = 1,          /* ente_tcp_bdp: cwnd = gain x BDP */
+	ENTE_MODE_L4S = 2,          /* ente_tcp_l4s: scalable ECN response */
+};
+
+/* Tuning profile of a registered variant
+ * 
+ * Only ever passed as the address of one of the static const profiles
+ * below into __always_inline functions, so every field folds into the
+ * generated code as an immediate: no extra loads or branches per ACK.
+ */
+struct ente_tcp_profile {
+	enum ente_tcp_mode mode;
+	u16 high_entropy;            /* Above this is noise */
+	u16 low_entropy;             /* Below this is congestion */
+	u16 noise_aggression;        /* Noise-mode increase, x1000 of Reno */
+	u16 congestion_conserve;     /* Congestion-mode increase, x1000 of Reno */
+	u16 noise_reduction;         /* Noise loss without BWE: cwnd - cwnd / N */
+	u16 pacing_noise_gain;       /* Noise-mode pacing gain, percent */
+	u8 window;                   /* Fixed entropy window (0 = multi-scale) */
+	u8 rtt0_ms;                  /* Hybla reference RTT (0 = no RTT scaling) */
+};
+
+#define ENTE_TCP_PROFILE_DEFAULTS \
+	.high_entropy = HIGH_ENTROPY_THRESHOLD, \
+	.low_entropy = LOW_ENTROPY_THRESHOLD, \
+	.noise_aggression = NOISE_AGGRESSION, \
+	.congestion_conserve = CONGESTION_CONSERVE, \
+	.noise_reduction = NOISE_REDUCTION_FACTOR, \
+	.pacing_noise_gain = PACING_NOISE_GAIN
+
+static const struct ente_tcp_profile ente_tcp_profile_default = {
+	.mode = ENTE_MODE_RENO,
+	ENTE_TCP_PROFILE_DEFAULTS,
+};
+
+static const struct ente_tcp_profile ente_tcp_profile_bdp = {
+	.mode = ENTE_MODE_BDP,
+	ENTE_TCP_PROFILE_DEFAULTS,
+};
+
+static const struct ente_tcp_profile ente_tcp_profile_l4s = {
+	.mode = ENTE_MODE_L4S,
+	ENTE_TCP_PROFILE_DEFAULTS,
+};
+
+/* Wi-Fi: contention and retries make jitter the norm, so call noise
+ * earlier; shallow AP buffers get noise-mode growth paced at cwnd / srtt
+ */
+static const struct ente_tcp_profile ente_tcp_profile_wifi = {
+	.mode = ENTE_MODE_RENO,
+	.high_entropy = 450,
+	.low_entropy = LOW_ENTROPY_THRESHOLD,
+	.noise_aggression = NOISE_AGGRESSION,
+	.congestion_conserve = CONGESTION_CONSERVE,
+	.noise_reduction = NOISE_REDUCTION_FACTOR,
+	.pacing_noise_gain = 100,
+};
+
+/* Cellular: scheduler delay ramps look orderly, so call congestion later;
+ * deep base station buffers bloat quickly, so grow less on noise. Link
+ * layer retransmission makes most losses that reach TCP random: cut 1/4.
+ */
+static const struct ente_tcp_profile ente_tcp_profile_cell = {
+	.mode = ENTE_MODE_RENO,
+	.high_entropy = HIGH_ENTROPY_THRESHOLD,
+	.low_entropy = 200,
+	.noise_aggression = 1250,
+	.congestion_conserve = CONGESTION_CONSERVE,
+	.noise_reduction = 4,
+	.pacing_noise_gain = PACING_NOISE_GAIN,
+};
+
+/* Satellite: long RTTs make every increase step slow to pay off, so grow
+ * faster in both states, scale the increase with RTT like Hybla and cut
+ * less on noise. The 64-sample window spans more than one RTT of a GEO
+ * path at typical rates.
+ */
+static const struct ente_tcp_profile ente_tcp_profile_sat = {
+	.mode = ENTE_MODE_RENO,
+	.high_entropy = 450,
+	.low_entropy = LOW_ENTROPY_THRESHOLD,
+	.noise_aggression = 2000,
+	.congestion_conserve = 750,
+	.noise_reduction = 4,
+	.pacing_noise_gain = PACING_NEUTRAL_GAIN,
+	.window = 64,
+	.rtt0_ms = HYBLA_RTT0_MS,
+};
+
+/* Data center: RTT variation at microsecond scale is almost all queueing,
+ * so call congestion sooner and never grow faster than Reno
+ */
+static const struct ente_tcp_profile ente_tcp_profile_dc = {
+	.mode = ENTE_MODE_RENO,
+	.high_entropy = 600,
+	.low_entropy = 400,
+	.noise_aggression = 1000,
+	.congestion_conserve = CONGESTION_CONSERVE,
+	.noise_reduction = NOISE_REDUCTION_FACTOR,
+	.pacing_noise_gain = 100,
+};
+
+/* Window-size variants: ente_tcp with entropy always computed over exactly
+ * this many samples, to benchmark accuracy against cycles
+ */
+static const struct ente_tcp_profile ente_tcp_profile_w8 = {
+	.mode = ENTE_MODE_RENO,
+	ENTE_TCP_PROFILE_DEFAULTS,
+	.window = 8,
+};
+
+static const struct ente_tcp_profile ente_tcp_profile_w16 = {
+	.mode = ENTE_MODE_RENO,
+	ENTE_TCP_PROFILE_DEFAULTS,
+	.window = 16,
+};
+
+static const struct ente_tcp_profile ente_tcp_profile_w32 = {
+	.mode = ENTE_MODE_RENO,
+	ENTE_TCP_PROFILE_DEFAULTS,
+	.window = 32,
+};
+
+static const struct ente_tcp_profile ente_tcp_profile_w64 = {
+	.mode = ENTE_MODE_RENO,
+	ENTE_TCP_PROFILE_DEFAULTS,
+	.window = 64,
+};
+
+/* Extended per-flow state for long-lived flows
+ *
+ * Too large for ICSK_CA_PRIV_SIZE, so it lives in its own kmem_cache and is
+ * referenced from struct ente_tcp. Short flows never allocate it; it is
+ * freed in ente_tcp_release().
+ */
+struct ente_tcp_ext {
+	/* Long RTT history, same format as the private window */
+	u16 rtt_history[EXT_WINDOW_SIZE]; /* RTT samples in ms */
+	u16 history_index;           /* Current position in circular buffer */
+	u16 history_count;           /* Number of samples collected */
+	
+	/* Entropy over the newest 16, 32 and 64 samples (scaled x1000) */
+	u16 scale_entropy[EXT_SCALES];
+	
+	/* Decision history: newest classification in the low bits */
+	u64 decision_history;        /* Last 32 decisions, 2 bits each */
+	u32 decision_count[3];       /* Totals per enum ente_tcp_state */
+	
+	/* Loss inter-arrival gaps, same ring format as the RTT windows */
+	u16 loss_gap_pkts[LOSS_GAP_WINDOW]; /* Packets delivered between losses */
+	u16 loss_gap_ms[LOSS_GAP_WINDOW];   /* Time between losses in ms */
+	u32 loss_delivered;          /* tp->delivered at the last loss */
+	u32 loss_stamp;              /* tcp_jiffies32 at the last loss */
+	u8 loss_gap_index;           /* Next write position in both rings */
+	u8 loss_gap_count;           /* Number of gaps collected */
+	u16 loss_entropy;            /* Mean entropy of both gap rings (x1000) */
+	
+	/* Change-point detection, see ente_tcp_path_changed() */
+	u32 cp_mean_us;              /* Reference srtt, 0 until the first update */
+	u32 cp_up;                   /* CUSUM of increases beyond the slack */
+	u32 cp_down;                 /* CUSUM of decreases beyond the slack */
+	u32 cp_level_us;             /* Pending rise: srtt level before it, or 0 */
+	u16 cp_level_round;          /* Pending rise: round it was detected in */
+	u16 round;                   /* Completed rounds (wrapping) */
+	
+	u32 event_stamp;             /* tcp_jiffies32 at the last event */
+	
+	/* Periodicity: raw RTT over min_rtt, lowest per time slot */
+	u16 prd_slots[PERIODIC_SLOTS]; /* Oldest first from prd_head + 1 */
+	u32 prd_slot;                /* tcp_mstamp >> PERIODIC_SLOT_SHIFT, newest */
+	u16 prd_head;                /* Ring position of the newest slot */
+	u16 prd_count;               /* Slots filled */
+	u16 prd_new;                 /* Slots added since the last check */
+};
+
+static struct kmem_cache *ente_tcp_ext_cachep __read_mostly;
+
+/* Warm-start cache key: destination address masked to a prefix */
+struct ente_tcp_dst {
+	__be32 addr[4];              /* IPv4 uses addr[0] only */
+	u16 family;                  /* AF_INET or AF_INET6 */
+};
+
+/* Warm-start cache entry: path knowledge left behind by a closed flow */
+struct ente_tcp_cache_entry {
+	struct hlist_node node;
+	struct rcu_head rcu;
+	struct ente_tcp_dst dst;
+	unsigned long stamp;         /* jiffies of last update */
+	u32 min_rtt_us;              /* Last minimum RTT */
+	u32 ssthresh;                /* Last ssthresh (0 = never had a loss) */
+	u16 entropy;                 /* Last entropy (scaled x1000) */
+	u8 state;                    /* Last enum ente_tcp_state */
+};
+
+/* Per-netns statistics, shown in /proc/net/ente_tcp */
+enum {
+	ENTE_STAT_FLOWS_NEUTRAL,     /* Gauges: flows per enum ente_tcp_state */
+	ENTE_STAT_FLOWS_NOISE,
+	ENTE_STAT_FLOWS_CONGESTION,
+	ENTE_STAT_ENTROPY_UPDATES,   /* Entropy recomputations */
+	ENTE_STAT_STATE_CHANGES,     /* Classification transitions */
+	ENTE_STAT_SSTHRESH_NOISE,    /* Reductions: BWE x min RTT or 2/3 */
+	ENTE_STAT_SSTHRESH_CONGESTION, /* Reductions: 1/2 */
+	ENTE_STAT_SSTHRESH_ECN,      /* Reductions on ECN-Echo */
+	ENTE_STAT_UNDOS,             /* Reductions undone as spurious */
+	ENTE_STAT_REORDER_RECOVERIES, /* Recoveries treated as reordering */
+	ENTE_STAT_RTO_RESTARTS,      /* Post-RTO jumps back to ssthresh */
+	ENTE_STAT_BDP_CAPPED,        /* Noise-mode growth hit the BDP cap */
+	ENTE_STAT_EXT_ALLOCS,        /* Extended state allocated */
+	ENTE_STAT_EXT_ALLOC_FAILS,   /* Extended state allocation failed */
+	ENTE_STAT_CACHE_HITS,        /* Flows seeded from the warm-start cache */
+	ENTE_STAT_EVENTS,            /* Classification events sent */
+	ENTE_STAT_PERIODIC,          /* Entropy updates that found periodic RTT */
+	ENTE_STAT_PATH_CHANGES,      /* RTT level shifts (route change, handover) */
+	ENTE_STAT_MAX
+};
+
+static const char * const ente_tcp_stat_names[ENTE_STAT_MAX] = {
+	[ENTE_STAT_FLOWS_NEUTRAL]	= "flows_neutral",
+	[ENTE_STAT_FLOWS_NOISE]		= "flows_noise",
+	[ENTE_STAT_FLOWS_CONGESTION]	= "flows_congestion",
+	[ENTE_STAT_ENTROPY_UPDATES]	= "entropy_updates",
+	[ENTE_STAT_STATE_CHANGES]	= "state_changes",
+	[ENTE_STAT_SSTHRESH_NOISE]	= "ssthresh_noise",
+	[ENTE_STAT_SSTHRESH_CONGESTION]	= "ssthresh_congestion",
+	[ENTE_STAT_SSTHRESH_ECN]	= "ssthresh_ecn",
+	[ENTE_STAT_UNDOS]		= "undos",
+	[ENTE_STAT_REORDER_RECOVERIES]	= "reorder_recoveries",
+	[ENTE_STAT_RTO_RESTARTS]	= "rto_restarts",
+	[ENTE_STAT_BDP_CAPPED]		= "bdp_capped",
+	[ENTE_STAT_EXT_ALLOCS]		= "ext_allocs",
+	[ENTE_STAT_EXT_ALLOC_FAILS]	= "ext_alloc_fails",
+	[ENTE_STAT_CACHE_HITS]		= "cache_hits",
+	[ENTE_STAT_EVENTS]		= "events",
+	[ENTE_STAT_PERIODIC]		= "periodic",
+	[ENTE_STAT_PATH_CHANGES]	= "path_changes",
+};
+
+/* Per-CPU, so updates from softirq on many cores never share a line */
+struct ente_tcp_mib {
+	unsigned long mibs[ENTE_STAT_MAX];
+};
+
+/* Log-linear histograms: 2^sub buckets per power of two, exact below 2^sub */
+#define HIST_BUCKETS(bits, sub) (((bits) - (sub) + 1) << (sub))
+#define HIST_ENTROPY_BITS 10        /* Entropy is 0-1000 */
+#define HIST_ENTROPY_SUB 4          /* 16 per octave: edges at 304, 496 */
+#define HIST_VARIANCE_BITS 32       /* RTT variance in ms^2 */
+#define HIST_VARIANCE_SUB 2         /* 4 per octave */
+
+/* Distributions of each recomputed entropy and variance, per CPU */
+struct ente_tcp_hist {
+	u32 entropy[HIST_BUCKETS(HIST_ENTROPY_BITS, HIST_ENTROPY_SUB)];
+	u32 variance[HIST_BUCKETS(HIST_VARIANCE_BITS, HIST_VARIANCE_SUB)];
+};
+
+/* Per-netns data */
+struct ente_tcp_net {
+	spinlock_t cache_lock;       /* Serialises cache writers */
+	unsigned int cache_count;    /* Entries in cache[] */
+	struct hlist_head cache[1 << CACHE_HASH_BITS];
+	struct ente_tcp_mib __percpu *stats;
+	struct ente_tcp_hist __percpu *hist;
+};
+
+static unsigned int ente_tcp_net_id __read_mostly;
+static u32 ente_tcp_cache_seed __read_mostly;
+
+static struct ente_tcp_mib __percpu *ente_tcp_stats(const struct sock *sk)
+{
+	struct ente_tcp_net *tn = net_generic(sock_net(sk), ente_tcp_net_id);
+	
+	return tn->stats;
+}
+
+#define ENTE_TCP_INC_STATS(sk, field) \
+	this_cpu_inc(ente_tcp_stats(sk)->mibs[field])
+#define ENTE_TCP_DEC_STATS(sk, field) \
+	this_cpu_dec(ente_tcp_stats(sk)->mibs[field])
+
+static __always_inline u32 ente_tcp_hist_bucket(u32 v, u32 sub)
+{
+	u32 e;
+	
+	if (v < (1U << sub))
+		return v;
+	
+	e = ilog2(v);
+	return ((e - sub + 1) << sub) + ((v >> (e - sub)) & ((1U << sub) - 1));
+}
+
+/* Smallest value that falls into bucket @b */
+static u32 ente_tcp_hist_lower(u32 b, u32 sub)
+{
+	u32 e;
+	
+	if (b < (1U << sub))
+		return b;
+	
+	e = (b >> sub) + sub - 1;
+	return ((1U << sub) | (b & ((1U << sub) - 1))) << (e - sub);
+}
+
+static void ente_tcp_hist_record(const struct sock *sk, u32 entropy,
+				 u32 variance)
+{
+	struct ente_tcp_net *tn = net_generic(sock_net(sk), ente_tcp_net_id);
+	
+	this_cpu_inc(tn->hist->entropy[ente_tcp_hist_bucket(entropy,
+							    HIST_ENTROPY_SUB)]);
+	this_cpu_inc(tn->hist->variance[ente_tcp_hist_bucket(variance,
+							     HIST_VARIANCE_SUB)]);
+}
+
+/* Hot-path self-profiling (debugfs ente_tcp/), off unless enabled
+ * 
+ * Cycles per call of the sites below go into per-CPU count/sum/min/max and
+ * a log-linear histogram for percentiles. While disabled, the static key
+ * leaves a single no-op in the hot path.
+ */
+enum ente_tcp_prof_site {
+	ENTE_PROF_CONG_AVOID,
+	ENTE_PROF_ENTROPY,
+	ENTE_PROF_SSTHRESH,
+	ENTE_PROF_MAX
+};
+
+static const char * const ente_tcp_prof_names[ENTE_PROF_MAX] = {
+	[ENTE_PROF_CONG_AVOID]	= "ente_tcp_cong_avoid",
+	[ENTE_PROF_ENTROPY]	= "calculate_entropy",
+	[ENTE_PROF_SSTHRESH]	= "ente_tcp_ssthresh",
+};
+
+#define PROF_BITS 32                /* Cycles per call, saturated to u32 */
+#define PROF_SUB 2                  /* 4 buckets per octave (~19% wide) */
+#define PROF_BUCKETS HIST_BUCKETS(PROF_BITS, PROF_SUB)
+
+struct ente_tcp_prof {
+	u64 count;
+	u64 sum;
+	u32 min;
+	u32 max;
+	u32 hist[PROF_BUCKETS];
+};
+
+static DEFINE_STATIC_KEY_FALSE(ente_tcp_prof_key);
+static struct ente_tcp_prof __percpu *ente_tcp_prof;
+
+static noinline void ente_tcp_prof_record(enum ente_tcp_prof_site site,
+					  u64 cycles)
+{
+	struct ente_tcp_prof *p = get_cpu_ptr(ente_tcp_prof) + site;
+	u32 c = min_t(u64, cycles, U32_MAX);
+	
+	if (!p->count || c < p->min)
+		p->min = c;
+	if (c > p->max)
+		p->max = c;
+	p->count++;
+	p->sum += c;
+	p->hist[ente_tcp_hist_bucket(c, PROF_SUB)]++;
+	put_cpu_ptr(ente_tcp_prof);
+}
+
+static __always_inline u64 ente_tcp_prof_start(void)
+{
+	if (static_branch_unlikely(&ente_tcp_prof_key))
+		return get_cycles();
+	return 0;
+}
+
+static __always_inline void ente_tcp_prof_end(enum ente_tcp_prof_site site,
+					      u64 start)
+{
+	if (static_branch_unlikely(&ente_tcp_prof_key) && start)
+		ente_tcp_prof_record(site, get_cycles() - start);
+}
+
+/* Per-ACK trace export, off unless enabled
+ * 
+ * Records go into a per-CPU relay channel created on first enable and kept
+ * until module unload. Writers only touch their own CPU's buffer with
+ * interrupts off, so nothing is shared or locked on the ACK path; a full
+ * buffer drops records rather than overwriting unread ones.
+ */
+static DEFINE_STATIC_KEY_FALSE(ente_tcp_trace_key);
+static struct rchan *ente_tcp_trace_chan;
+static DEFINE_MUTEX(ente_tcp_trace_lock);
+
 /* Compact ENTE-TCP private data structure */
 struct ente_tcp {
 	/* TCP state tracking */
 	u32 min_rtt_us;              /* Minimum RTT observed (baseline) */
-	u32 prior_cwnd;              /* Previous congestion window */
 	u32 ssthresh;                /* Slow start threshold */
 	
 	/* RTT history for entropy calculation */
 	u16 rtt_history[ENTROPY_WINDOW_SIZE]; /* RTT samples in ms */
-	u16 history_index;           /* Current position in circular buffer */
-	u16 history_count;           /* Number of samples collected */
+	u8 history_index;            /* Current position in circular buffer */
+	u8 history_count;            /* Number of samples collected */
 	
 	/* Entropy metrics */
 	u16 shannon_entropy;         /* Current entropy (scaled x1000) */
 	u16 packets_acked;           /* Counter for periodic entropy calc */
 	
+	/* Round trip tracking */
+	u16 round_count;             /* Completed rounds (saturating) */
+	u32 round_end_seq;           /* snd_nxt when the current round began */
+	
 	/* RTT variance tracking */
 	u32 rtt_variance;            /* RTT variance for quick checks */
 	u32 avg_rtt_us;              /* Average RTT */
 	
+	u32 min_rtt_stamp;           /* When min_rtt_us was last refreshed */
+	
+	/* Slow start exit: minimum RTT sample this round */
+	u32 round_min_rtt_us;
+	
+	/* Delivery rate max filter, two sub-windows of BW_FILTER_ROUNDS */
+	u32 bw_max_cur;              /* Max bw of the current sub-window */
+	u32 bw_max_prev;             /* Max bw of the previous sub-window */
+	
+	/* ECN: delivered and CE-marked packets at the start of the round */
+	u32 ecn_delivered;
+	u32 ecn_delivered_ce;
+	u16 ecn_alpha;               /* DCTCP-style CE fraction (scaled x1024) */
+	
 	/* State flags */
 	u8 has_entropy_data:1,       /* Have enough samples for entropy */
 	   in_slow_start:1,          /* Currently in slow start phase */
 	   is_noise:1,               /* High entropy = noise detected */
 	   is_congestion:1,          /* Low entropy = congestion detected */
 	   loss_event:1,             /* Recent packet loss */
-	   reserved:3;               /* Reserved bits */
+	   tracking:1,               /* Entropy bookkeeping active */
+	   ecn_ce_round:1,           /* ECE seen in the current round */
+	   ecn_marking:1;            /* Path has shown it marks CE */
+	u8 confidence:2,             /* Idle restarts left before state is dropped */
+	   round_samples:4,          /* Slow start exit: RTT samples this round */
+	   bdp_capped:1,             /* Noise-mode growth held at the BDP cap */
+	   is_periodic:1;            /* RTT oscillates with a fixed period */
+	
+	/* Long-lived flows only, NULL until ente_tcp_ext_try_alloc() */
+	struct ente_tcp_ext *ext;
+	
+	/* Spurious-loss rate, see ente_tcp_count_loss() */
+	u8 loss_episodes;            /* Loss episodes in the current window */
+	u8 undo_events;              /* Of those, later undone as spurious */
+	u8 reord_seen;               /* tp->reord_seen at the last round boundary */
+	u8 recovery_state;           /* Loss-path verdict at Recovery/Loss entry */
+	
+	/* Classification events, see ente_tcp_notify() */
+	u8 event_state:2,            /* State userspace was last told about */
+	   classified:1,             /* Verdict of its own, not only seeded */
+	   ack_una:1,                /* This ACK advanced snd_una */
+	   ack_ece:1;                /* This ACK carried ECN-Echo */
+	
+	u8 min_rtt_probe;            /* Rounds left measuring a fresh min_rtt */
+	u8 bw_round;                 /* Rounds into the bandwidth sub-window */
 };
 
+/* log2(x) x 1000 for x >= 1, linear between powers of two (error < 0.09) */
+static u32 log2_milli(u32 x)
+{
+	u32 k = ilog2(x);
+	
+	return k * 1000 + (u32)(((u64)(x - (1U << k)) * 1000) >> k);
+}
+
 /* Helper: Calculate Shannon entropy from RTT history
  * 
  * Shannon Entropy Formula: H = -Σ(p_i * log2(p_i))
@@ -83,28 +738,33 @@ struct ente_tcp {
  * 
  * High entropy = random/unpredictable (noise)
  * Low entropy = predictable/consistent (congestion)
+ * 
+ * Works on the newest @count samples of a circular buffer of @size
+ * entries (power of two) whose next write position is @head, so the
+ * private window and the extended window share one implementation.
  */
-static u32 calculate_entropy(struct ente_tcp *ca)
+static u32 __calculate_entropy(const u16 *ring, u32 size, u32 head, u32 count)
 {
 	u32 histogram[HISTOGRAM_BINS] = {0};
-	u32 i, count;
+	u32 i, pos;
 	u16 min_val, max_val, range, bin;
 	u64 entropy = 0;
 	u32 total;
 	
 	/* Need minimum samples for reliable entropy */
-	if (ca->history_count < 8)
+	if (count < ENTROPY_MIN_SAMPLES)
 		return 0;
 	
-	count = min_t(u32, ca->history_count, ENTROPY_WINDOW_SIZE);
+	count = min_t(u32, count, size);
 	
 	/* Find min and max RTT for binning */
-	min_val = max_val = ca->rtt_history[0];
+	min_val = max_val = ring[(head - 1) & (size - 1)];
 	for (i = 0; i < count; i++) {
-		if (ca->rtt_history[i] < min_val)
-			min_val = ca->rtt_history[i];
-		if (ca->rtt_history[i] > max_val)
-			max_val = ca->rtt_history[i];
+		pos = (head - 1 - i) & (size - 1);
+		if (ring[pos] < min_val)
+			min_val = ring[pos];
+		if (ring[pos] > max_val)
+			max_val = ring[pos];
 	}
 	
 	range = max_val - min_val;
@@ -115,42 +775,111 @@ static u32 calculate_entropy(struct ente_tcp *ca)
 	
 	/* Build histogram: distribute RTT values into bins */
 	for (i = 0; i < count; i++) {
+		pos = (head - 1 - i) & (size - 1);
 		/* Map RTT value to bin number (0 to HISTOGRAM_BINS-1) */
-		bin = ((u32)(ca->rtt_history[i] - min_val) * (HISTOGRAM_BINS - 1)) / range;
+		bin = ((u32)(ring[pos] - min_val) * (HISTOGRAM_BINS - 1)) / range;
 		bin = min_t(u16, bin, HISTOGRAM_BINS - 1);
 		histogram[bin]++;
 	}
 	
-	/* Calculate Shannon entropy: H = -Σ(p * log2(p)) */
+	/* Calculate Shannon entropy: H = -Σ(p * log2(p))
+	 * With p = n / total: H = Σ n * (log2(total) - log2(n)) / total
+	 */
 	total = count;
 	for (i = 0; i < HISTOGRAM_BINS; i++) {
-		if (histogram[i] > 0) {
-			/* Calculate probability (scaled to avoid float) */
-			u64 p = (histogram[i] * 1000000ULL) / total;
-			
-			/* Approximate log2(p) using bit operations */
-			u32 log_p = 0;
-			if (p > 0) {
-				/* Count leading zeros gives us log2 approximation */
-				log_p = 32 - __builtin_clz((u32)(p / 1000));
-				log_p *= 1000; /* Scale back */
-			}
-			
-			/* Accumulate: -p * log2(p) */
-			entropy += (p * log_p) / 1000000;
-		}
+		if (histogram[i] > 0)
+			entropy += histogram[i] * (u64)(log2_milli(total) -
+							log2_milli(histogram[i]));
 	}
+	entropy = div_u64(entropy, total);
 	
 	/* Normalize entropy to 0-1000 range */
 	/* Theoretical max entropy for 16 bins is 4 bits */
 	return (u32)min_t(u64, entropy / 4, 1000);
 }
 
+static u32 calculate_entropy(const u16 *ring, u32 size, u32 head, u32 count)
+{
+	u64 prof = ente_tcp_prof_start();
+	u32 entropy = __calculate_entropy(ring, size, head, count);
+	
+	ente_tcp_prof_end(ENTE_PROF_ENTROPY, prof);
+	return entropy;
+}
+
+/* Fixed-size entropy kernels for the window-size variants
+ * 
+ * Same result as __calculate_entropy() over the newest @n samples of a
+ * ring of @size entries holding at least @n, with @bins histogram bins.
+ * All three are constants, so the loops unroll fully, the division by the
+ * sample count is a shift and log2(count) is folded. The per-sample
+ * division by the range becomes one rounded-up reciprocal, which gives
+ * exactly the same bins because range^2 < 2^32.
+ */
+#define ENTE_UNROLL _Pragma("GCC unroll 64")
+
+#define ENTE_TCP_ENTROPY_KERNEL(n, bins, size)				\
+static u32 __calculate_entropy_##n(const u16 *ring, u32 head)		\
+{									\
+	u8 histogram[bins] = {0};					\
+	u16 min_val = U16_MAX, max_val = 0, v;				\
+	u64 entropy = 0, scale;						\
+	u32 i;								\
+									\
+	BUILD_BUG_ON_NOT_POWER_OF_2(n);					\
+	BUILD_BUG_ON((n) > (size) || (n) > U8_MAX);			\
+									\
+	ENTE_UNROLL							\
+	for (i = 0; i < (n); i++) {					\
+		v = ring[(n) == (size) ? i : (head - 1 - i) & ((size) - 1)]; \
+		min_val = min(min_val, v);				\
+		max_val = max(max_val, v);				\
+	}								\
+	if (min_val == max_val)						\
+		return 0;						\
+									\
+	scale = div_u64(((u64)((bins) - 1) << 32) + max_val - min_val - 1, \
+			max_val - min_val);				\
+	ENTE_UNROLL							\
+	for (i = 0; i < (n); i++) {					\
+		v = ring[(n) == (size) ? i : (head - 1 - i) & ((size) - 1)]; \
+		histogram[((v - min_val) * scale) >> 32]++;		\
+	}								\
+									\
+	ENTE_UNROLL							\
+	for (i = 0; i < (bins); i++)					\
+		if (histogram[i])					\
+			entropy += histogram[i] *			\
+				   (u64)(ilog2(n) * 1000 -		\
+					 log2_milli(histogram[i]));	\
+									\
+	/* Normalize by the maximum, log2(bins) bits */			\
+	return min_t(u32, (u32)(entropy / (n)) / ilog2(bins), 1000);	\
+}									\
+									\
+static u32 calculate_entropy_##n(const u16 *ring, u32 head)		\
+{									\
+	u64 prof = ente_tcp_prof_start();				\
+	u32 entropy = __calculate_entropy_##n(ring, head);		\
+									\
+	ente_tcp_prof_end(ENTE_PROF_ENTROPY, prof);			\
+	return entropy;							\
+}
+
+/* Bins: one per sample up to HISTOGRAM_BINS, so 8 samples are not spread
+ * over 16 mostly empty bins
+ */
+ENTE_TCP_ENTROPY_KERNEL(8, 8, ENTROPY_WINDOW_SIZE)
+ENTE_TCP_ENTROPY_KERNEL(16, HISTOGRAM_BINS, ENTROPY_WINDOW_SIZE)
+ENTE_TCP_ENTROPY_KERNEL(32, HISTOGRAM_BINS, EXT_WINDOW_SIZE)
+ENTE_TCP_ENTROPY_KERNEL(64, HISTOGRAM_BINS, EXT_WINDOW_SIZE)
+
 /* Helper: Calculate RTT variance for additional confirmation */
 static void update_rtt_stats(struct ente_tcp *ca)
 {
-	u32 i, count, sum = 0;
+	u32 i, pos, count, sum = 0;
 	u64 variance_sum = 0;
+	s64 diff;
 	u32 avg;
 	
 	if (ca->history_count < 4)
@@ -158,90 +887,1133 @@ static void update_rtt_stats(struct ente_tcp *ca)
 	
 	count = min_t(u32, ca->history_count, ENTROPY_WINDOW_SIZE);
 	
-	/* Calculate average */
+	/* Calculate average over the newest @count samples, walking back
+	 * from the write position like __calculate_entropy(): after an idle
+	 * decay or a path reset the low slots are not the newest ones
+	 */
 	for (i = 0; i < count; i++) {
-		sum += ca->rtt_history[i];
+		pos = (ca->history_index - 1 - i) & (ENTROPY_WINDOW_SIZE - 1);
+		sum += ca->rtt_history[pos];
 	}
 	avg = sum / count;
 	ca->avg_rtt_us = avg * 1000; /* Convert ms to us */
 	
-	/* Calculate variance */
+	/* Calculate variance; 64-bit, as a diff of more than ~46 s
+	 * (possible with 16-bit ms samples) would overflow its square
+	 */
 	for (i = 0; i < count; i++) {
-		s32 diff = (s32)ca->rtt_history[i] - (s32)avg;
+		pos = (ca->history_index - 1 - i) & (ENTROPY_WINDOW_SIZE - 1);
+		diff = (s32)ca->rtt_history[pos] - (s32)avg;
 		variance_sum += (u64)(diff * diff);
 	}
-	ca->rtt_variance = (u32)(variance_sum / count);
+	ca->rtt_variance = (u32)div_u64(variance_sum, count);
 }
 
-/* Initialize ENTE-TCP on new connection */
-static void ente_tcp_init(struct sock *sk)
+/* Extended state: lazily allocate once a flow has proven long-lived
+ * 
+ * Called once per round. Allocation failure is not an error, the flow
+ * simply keeps using the private 16-sample window and retries next round.
+ * @now skips the lifetime thresholds, for variants that need the long
+ * window from the start.
+ */
+static void ente_tcp_ext_try_alloc(struct sock *sk, struct ente_tcp *ca,
+				   bool now)
 {
-	struct tcp_sock *tp = tcp_sk(sk);
-	struct ente_tcp *ca = inet_csk_ca(sk);
+	const struct tcp_sock *tp = tcp_sk(sk);
 	
-	/* Initialize state */
-	ca->min_rtt_us = U32_MAX;
-	ca->ssthresh = tp->snd_ssthresh;
-	ca->prior_cwnd = tp->snd_cwnd;
-	ca->history_index = 0;
-	ca->history_count = 0;
-	ca->shannon_entropy = 0;
-	ca->packets_acked = 0;
-	ca->rtt_variance = 0;
-	ca->avg_rtt_us = 0;
+	if (!ext_state)
+		return;
 	
-	/* Clear flags */
-	ca->has_entropy_data = 0;
-	ca->in_slow_start = 1;
-	ca->is_noise = 0;
-	ca->is_congestion = 0;
-	ca->loss_event = 0;
-	ca->reserved = 0;
+	if (!now && ca->round_count < ext_min_rounds &&
+	    tp->bytes_acked < ext_min_bytes)
+		return;
 	
-	/* Clear RTT history */
-	memset(ca->rtt_history, 0, sizeof(ca->rtt_history));
+	ca->ext = kmem_cache_zalloc(ente_tcp_ext_cachep,
+				    GFP_ATOMIC | __GFP_NOWARN);
+	if (!ca->ext) {
+		ENTE_TCP_INC_STATS(sk, ENTE_STAT_EXT_ALLOC_FAILS);
+		return;
+	}
 	
-	/* Start with infinite ssthresh (standard behavior) */
-	tp->snd_ssthresh = TCP_INFINITE_SSTHRESH;
+	ca->ext->loss_delivered = tp->delivered;
+	ca->ext->loss_stamp = tcp_jiffies32;
+	ca->ext->event_stamp = tcp_jiffies32 -
+			       msecs_to_jiffies(event_interval_ms);
+	ENTE_TCP_INC_STATS(sk, ENTE_STAT_EXT_ALLOCS);
 }
 
-/* Main congestion control logic - called on each ACK */
-static void ente_tcp_cong_avoid(struct sock *sk, u32 ack, u32 acked)
+/* Extended state: store one RTT sample in the long window */
+static void ente_tcp_ext_add_sample(struct ente_tcp_ext *ext, u16 rtt_ms)
 {
-	struct tcp_sock *tp = tcp_sk(sk);
-	struct ente_tcp *ca = inet_csk_ca(sk);
-	u32 rtt_us, rtt_ms;
+	ext->rtt_history[ext->history_index] = rtt_ms;
+	ext->history_index = (ext->history_index + 1) % EXT_WINDOW_SIZE;
+	if (ext->history_count < EXT_WINDOW_SIZE)
+		ext->history_count++;
+}
+
+/* Extended state: multi-scale entropy
+ * 
+ * Recomputes entropy over the newest 16, 32 and 64 samples and returns
+ * the value of the longest scale whose window is full. More samples per
+ * histogram give a steadier estimate for bulk flows. Falls back to
+ * @entropy (from the private window) until the first scale fills up.
+ */
+static u16 ente_tcp_ext_entropy(struct ente_tcp_ext *ext, u16 entropy)
+{
+	u32 scale, n;
 	
-	if (!acked)
-		return;
+	for (scale = 0; scale < EXT_SCALES; scale++) {
+		n = ENTROPY_WINDOW_SIZE << scale;
+		if (ext->history_count < n)
+			break;
+		
+		ext->scale_entropy[scale] = (u16)calculate_entropy(
+			ext->rtt_history, EXT_WINDOW_SIZE,
+			ext->history_index, n);
+		entropy = ext->scale_entropy[scale];
+	}
 	
-	/* Update packet counter */
-	ca->packets_acked += acked;
+	return entropy;
+}
+
+/* Window-size variants: entropy over exactly @window samples. 32 and 64
+ * need the extended window; until it has filled (or if it could not be
+ * allocated) they use the private 16-sample window like ente_tcp_w16.
+ */
+static __always_inline u16 ente_tcp_window_entropy(const struct ente_tcp *ca,
+						   u32 window)
+{
+	const struct ente_tcp_ext *ext = ca->ext;
 	
-	/* Get current smoothed RTT */
-	rtt_us = tp->srtt_us >> 3; /* srtt_us is scaled by 8 */
-	if (rtt_us == 0)
-		rtt_us = 1;
+	if (window == 8)
+		return calculate_entropy_8(ca->rtt_history, ca->history_index);
+	if (window == 32 && ext && ext->history_count >= 32)
+		return calculate_entropy_32(ext->rtt_history, ext->history_index);
+	if (window == 64 && ext && ext->history_count >= 64)
+		return calculate_entropy_64(ext->rtt_history, ext->history_index);
 	
-	/* Track minimum RTT (baseline for comparison) */
-	if (rtt_us < ca->min_rtt_us)
-		ca->min_rtt_us = rtt_us;
+	if (ca->history_count >= ENTROPY_WINDOW_SIZE)
+		return calculate_entropy_16(ca->rtt_history, ca->history_index);
+	return calculate_entropy(ca->rtt_history, ENTROPY_WINDOW_SIZE,
+				 ca->history_index, ca->history_count);
+}
+
+/* Periodicity: add one raw RTT sample, @excess_us over min_rtt
+ * 
+ * Slots are fixed in time, so lags are in time too, whatever the ACK
+ * rate. Each slot keeps its lowest sample; a slot no ACK fell in repeats
+ * the one before it. An idle gap longer than the window starts over.
+ */
+static void ente_tcp_periodic_sample(struct ente_tcp_ext *ext, u64 now_us,
+				     u32 excess_us)
+{
+	u32 slot = (u32)(now_us >> PERIODIC_SLOT_SHIFT);
+	u32 gap = slot - ext->prd_slot;
+	u16 v = min_t(u32, excess_us, U16_MAX), hold;
 	
-	/* Convert to milliseconds for storage (saves memory) */
-	rtt_ms = min_t(u32, rtt_us / 1000, 65535);
-	if (rtt_ms == 0)
-		rtt_ms = 1;
+	if (ext->prd_count && !gap) {
+		ext->prd_slots[ext->prd_head] = min(ext->prd_slots[ext->prd_head], v);
+		return;
+	}
+	if (!ext->prd_count || gap > PERIODIC_SLOTS) {
+		ext->prd_count = 0;
+		gap = 1;
+	}
 	
-	/* Store RTT in circular history buffer */
-	ca->rtt_history[ca->history_index] = (u16)rtt_ms;
-	ca->history_index = (ca->history_index + 1) % ENTROPY_WINDOW_SIZE;
-	if (ca->history_count < ENTROPY_WINDOW_SIZE)
-		ca->history_count++;
+	hold = ext->prd_slots[ext->prd_head];
+	ext->prd_slot = slot;
+	while (gap--) {
+		ext->prd_head = (ext->prd_head + 1) % PERIODIC_SLOTS;
+		ext->prd_slots[ext->prd_head] = gap ? hold : v;
+		if (ext->prd_count < PERIODIC_SLOTS)
+			ext->prd_count++;
+		ext->prd_new++;
+	}
+}
+
+/* Periodic RTT detection
+ *
+ * LTE/5G schedulers grant uplink and downlink in fixed slots (TTI) and
+ * put idle radios to sleep in fixed cycles (DRX), so RTT rises and falls
+ * with a steady period. The histogram sees a wide spread and reports high
+ * entropy, but nothing about it is random. Autocorrelation over the time
+ * slots finds such a component without knowing the period in advance: a
+ * periodic signal is anti-correlated with itself half a period out and
+ * correlated again a full period out, white noise is neither, and a trend
+ * or queue ramp never turns negative. Periods up to half the window are
+ * found: a 1 ms TTI (given a few ACKs per slot) up to a 40 ms DRX cycle.
+ * 
+ * Runs on raw samples, not the ms srtt the entropy uses, which smooths
+ * and quantizes a sub-ms swing away. Needs the extended state; the check
+ * is redone only every PERIODIC_RECHECK slots and the verdict kept
+ * in between.
+ */
+static bool ente_tcp_periodic(struct ente_tcp *ca)
+{
+	struct ente_tcp_ext *ext = ca->ext;
+	u32 n = PERIODIC_SLOTS, i, k;
+	s32 d[PERIODIC_SLOTS];
+	s64 r0 = 0, rk;
+	s32 sum = 0;
+	bool trough = false;
 	
-	/* Calculate entropy periodically (not every packet for efficiency) */
-	if (ca->packets_acked >= ENTROPY_CALC_INTERVAL) {
+	if (!ext || ext->prd_count < PERIODIC_SLOTS)
+		return false;
+	if (ext->prd_new < PERIODIC_RECHECK)
+		return ca->is_periodic;
+	ext->prd_new = 0;
+	
+	/* Deviations from the mean, scaled by n to stay integral */
+	for (i = 0; i < n; i++) {
+		d[i] = ext->prd_slots[(ext->prd_head + 1 + i) % n];
+		sum += d[i];
+	}
+	for (i = 0; i < n; i++) {
+		d[i] = d[i] * (s32)n - sum;
+		r0 += (s64)d[i] * d[i];
+	}
+	
+	/* r0 = n^3 x variance: ignore swings under PERIODIC_MIN_SWING_US */
+	if (r0 < (s64)n * n * n * PERIODIC_MIN_SWING_US * PERIODIC_MIN_SWING_US)
+		return false;
+	
+	for (k = 1; k <= n / 2; k++) {
+		rk = 0;
+		for (i = 0; i + k < n; i++)
+			rk += (s64)d[i] * d[i + k];
+		
+		if (rk * 1000 <= -PERIODIC_TROUGH * r0)
+			trough = true;
+		else if (trough && rk * 1000 >= PERIODIC_PEAK * r0)
+			return true;
+	}
+	
+	return false;
+}
+
+/* Change-point detection (route change, handover)
+ * 
+ * Two-sided CUSUM of srtt against a slow moving mean, run at each entropy
+ * update. Deviations beyond a slack of 1/8 of the mean accumulate; once
+ * either sum exceeds the mean itself the RTT level has shifted. A 50%
+ * step is found within about three updates, shifts under ~30% and jitter
+ * of the srtt are absorbed by the slack. Queue growth in congestion
+ * avoidance is far slower than the mean follows, so only slow start,
+ * recovery and CE-marked rounds, where RTT moves for other reasons, need
+ * to be excluded: the detector restarts from the current srtt there.
+ * 
+ * A rise looks the same whether the path got longer or cross traffic
+ * built a queue, so it only counts once it has held for CP_SHIFT_ROUNDS
+ * rounds; falling back to the old level first cancels it. A drop cannot
+ * come from a queue this flow or others add, so it counts at once.
+ * Needs the extended state; short flows rarely live through a handover.
+ */
+static enum ente_tcp_shift ente_tcp_path_changed(struct sock *sk,
+						 struct ente_tcp *ca,
+						 u32 rtt_us)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	struct ente_tcp_ext *ext = ca->ext;
+	u32 mean = ext->cp_mean_us, slack;
+	enum ente_tcp_shift shift = ENTE_SHIFT_NONE;
+	s64 dev;
+	
+	if (!mean || inet_csk(sk)->icsk_ca_state != TCP_CA_Open ||
+	    tcp_in_slow_start(tp) || ca->ecn_ce_round) {
+		ext->cp_level_us = 0;
+		goto restart;
+	}
+	
+	/* Pending rise: back at the old level, or held long enough */
+	if (ext->cp_level_us) {
+		slack = max_t(u32, ext->cp_level_us >> CP_SLACK_SHIFT,
+			      CP_SLACK_MIN_US);
+		if (rtt_us < ext->cp_level_us + slack) {
+			ext->cp_level_us = 0;
+			goto restart;
+		}
+		if ((u16)(ext->round - ext->cp_level_round) < CP_SHIFT_ROUNDS)
+			return ENTE_SHIFT_NONE;
+		ext->cp_level_us = 0;
+		shift = ENTE_SHIFT_UP;
+		goto restart;
+	}
+	
+	slack = max_t(u32, mean >> CP_SLACK_SHIFT, CP_SLACK_MIN_US);
+	dev = (s64)rtt_us - mean;
+	ext->cp_up = (u32)clamp_t(s64, ext->cp_up + dev - slack, 0, U32_MAX);
+	ext->cp_down = (u32)clamp_t(s64, ext->cp_down - dev - slack,
+				    0, U32_MAX);
+	ext->cp_mean_us = (u32)(mean + div_s64(dev, 1 << CP_MEAN_SHIFT));
+	
+	if (ext->cp_up > mean) {
+		ext->cp_level_us = mean;
+		ext->cp_level_round = ext->round;
+	} else if (ext->cp_down > mean) {
+		shift = ENTE_SHIFT_DOWN;
+	} else {
+		return ENTE_SHIFT_NONE;
+	}
+	
+restart:
+	/* Start over from the current srtt */
+	ext->cp_mean_us = rtt_us;
+	ext->cp_up = 0;
+	ext->cp_down = 0;
+	return shift;
+}
+
+/* The path has changed: forget what was learned about the old one
+ * 
+ * Both RTT windows keep only the newest sample so the next classification
+ * describes the new path (the old verdict stands until then). The
+ * periodicity slots start over.
+ * 
+ * Longer path: min_rtt is re-measured over one full round like an expired
+ * window (the old value stays in use until then). Bandwidth and ssthresh
+ * are left alone: if the rise was a queue after all, backing off is the
+ * right response, not probing.
+ * 
+ * Shorter path: min_rtt has already followed the raw samples down. The
+ * bandwidth filter starts over, and with change_reprobe ssthresh is
+ * raised to twice cwnd: at most one round of slow start, ended earlier by
+ * the delay-based exit measured against the new baseline.
+ */
+static void ente_tcp_path_reset(struct sock *sk, struct ente_tcp *ca,
+				enum ente_tcp_shift shift)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	
+	ENTE_TCP_INC_STATS(sk, ENTE_STAT_PATH_CHANGES);
+	
+	ca->history_count = 1;
+	ca->ext->history_count = 1;
+	ca->ext->prd_count = 0;
+	
+	if (shift == ENTE_SHIFT_UP) {
+		if (!ca->min_rtt_probe)
+			ca->min_rtt_probe = MIN_RTT_PROBE_ROUNDS;
+		return;
+	}
+	
+	ca->bw_max_cur = 0;
+	ca->bw_max_prev = 0;
+	ca->bw_round = 0;
+	
+	if (change_reprobe) {
+		ca->ssthresh = min(tp->snd_cwnd * 2, tp->snd_cwnd_clamp);
+		tp->snd_ssthresh = ca->ssthresh;
+	}
+}
+
+/* Extended state: append a classification to the decision history */
+static void ente_tcp_ext_record(struct ente_tcp_ext *ext,
+				enum ente_tcp_state state)
+{
+	ext->decision_history = (ext->decision_history << EXT_DECISION_BITS) |
+				state;
+	ext->decision_count[state]++;
+}
+
+/* Record one ACK's newly detected losses in the gap rings
+ * 
+ * The gap is measured since the previous loss in packets delivered and in
+ * time; further losses reported on the same ACK are a burst, gap 0.
+ */
+static void ente_tcp_ext_loss(struct ente_tcp_ext *ext,
+			      const struct tcp_sock *tp, u32 losses)
+{
+	u32 gap_pkts = tp->delivered - ext->loss_delivered;
+	u32 gap_ms = jiffies_to_msecs(tcp_jiffies32 - ext->loss_stamp);
+	u32 i, n = min_t(u32, losses, LOSS_GAP_WINDOW);
+	u32 pkts_entropy, ms_entropy;
+	
+	for (i = 0; i < n; i++) {
+		ext->loss_gap_pkts[ext->loss_gap_index] = min_t(u32, gap_pkts, U16_MAX);
+		ext->loss_gap_ms[ext->loss_gap_index] = min_t(u32, gap_ms, U16_MAX);
+		ext->loss_gap_index = (ext->loss_gap_index + 1) &
+				      (LOSS_GAP_WINDOW - 1);
+		gap_pkts = 0;
+		gap_ms = 0;
+	}
+	ext->loss_gap_count = min_t(u32, ext->loss_gap_count + n,
+				    LOSS_GAP_WINDOW);
+	ext->loss_delivered = tp->delivered;
+	ext->loss_stamp = tcp_jiffies32;
+	
+	pkts_entropy = calculate_entropy(ext->loss_gap_pkts, LOSS_GAP_WINDOW,
+					 ext->loss_gap_index, ext->loss_gap_count);
+	ms_entropy = calculate_entropy(ext->loss_gap_ms, LOSS_GAP_WINDOW,
+				       ext->loss_gap_index, ext->loss_gap_count);
+	ext->loss_entropy = (pkts_entropy + ms_entropy) / 2;
+}
+
+/* Loss path: does the loss pattern say noise?
+ * 
+ * Random (wireless) loss is memoryless, so the gaps between losses are
+ * spread widely: high gap entropy. Queue overflow drops packets in
+ * bursts, many near-zero gaps and a few long ones: low gap entropy. Once
+ * enough losses have been seen this overrides the RTT verdict.
+ */
+static bool ente_tcp_loss_is_noise(const struct ente_tcp *ca)
+{
+	const struct ente_tcp_ext *ext = ca->ext;
+	
+	if (ext && ext->loss_gap_count >= ENTROPY_MIN_SAMPLES) {
+		if (ext->loss_entropy > LOSS_GAP_HIGH_ENTROPY)
+			return true;
+		if (ext->loss_entropy < LOSS_GAP_LOW_ENTROPY)
+			return false;
+	}
+	
+	return ca->has_entropy_data && (ca->is_noise || ca->is_periodic);
+}
+
+/* Helper: current classification as an enum ente_tcp_state */
+static enum ente_tcp_state ente_tcp_get_state(const struct ente_tcp *ca)
+{
+	if (ca->is_noise)
+		return ENTE_STATE_NOISE;
+	if (ca->is_congestion)
+		return ENTE_STATE_CONGESTION;
+	return ENTE_STATE_NEUTRAL;
+}
+
+/* Helper: build the warm-start cache key of a connection */
+static bool ente_tcp_cache_key(const struct sock *sk, struct ente_tcp_dst *dst)
+{
+	memset(dst, 0, sizeof(*dst));
+	
+#if IS_ENABLED(CONFIG_IPV6)
+	if (sk->sk_family == AF_INET6 && !ipv6_addr_v4mapped(&sk->sk_v6_daddr)) {
+		struct in6_addr prefix;
+		
+		ipv6_addr_prefix(&prefix, &sk->sk_v6_daddr,
+				 min_t(u32, cache_prefix6, 128));
+		memcpy(dst->addr, &prefix, sizeof(prefix));
+		dst->family = AF_INET6;
+		return true;
+	}
+#endif
+	if (sk->sk_family != AF_INET && sk->sk_family != AF_INET6)
+		return false;
+	
+	dst->addr[0] = sk->sk_daddr & inet_make_mask(min_t(u32, cache_prefix4, 32));
+	dst->family = AF_INET;
+	return true;
+}
+
+static u32 ente_tcp_cache_hash(const struct ente_tcp_dst *dst)
+{
+	return hash_32(jhash2((const u32 *)dst->addr, 4,
+			      ente_tcp_cache_seed ^ dst->family),
+		       CACHE_HASH_BITS);
+}
+
+static bool ente_tcp_cache_expired(const struct ente_tcp_cache_entry *e)
+{
+	return time_after(jiffies, e->stamp + (unsigned long)cache_ttl * HZ);
+}
+
+/* Find a cache entry, caller holds rcu_read_lock or cache_lock */
+static struct ente_tcp_cache_entry *
+ente_tcp_cache_find(struct ente_tcp_net *tn, const struct ente_tcp_dst *dst)
+{
+	struct ente_tcp_cache_entry *e;
+	
+	hlist_for_each_entry_rcu(e, &tn->cache[ente_tcp_cache_hash(dst)], node,
+				 lockdep_is_held(&tn->cache_lock)) {
+		if (e->dst.family == dst->family &&
+		    !memcmp(e->dst.addr, dst->addr, sizeof(dst->addr)))
+			return e;
+	}
+	return NULL;
+}
+
+static void ente_tcp_cache_unlink(struct ente_tcp_net *tn,
+				  struct ente_tcp_cache_entry *e)
+{
+	hlist_del_rcu(&e->node);
+	tn->cache_count--;
+	kfree_rcu(e, rcu);
+}
+
+/* Warm start: seed a new flow from the last flow to the same prefix
+ * 
+ * Restores baseline RTT, classification and ssthresh so the flow does
+ * not have to relearn the path from scratch. Seeded flows skip the
+ * short-flow fast path since their classification is already usable.
+ */
+static void ente_tcp_cache_seed_flow(struct sock *sk, struct ente_tcp *ca)
+{
+	struct ente_tcp_net *tn = net_generic(sock_net(sk), ente_tcp_net_id);
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct ente_tcp_cache_entry *e;
+	struct ente_tcp_dst dst;
+	
+	if (!READ_ONCE(cache_size) || !ente_tcp_cache_key(sk, &dst))
+		return;
+	
+	rcu_read_lock();
+	e = ente_tcp_cache_find(tn, &dst);
+	if (e && !ente_tcp_cache_expired(e)) {
+		ca->min_rtt_us = READ_ONCE(e->min_rtt_us);
+		ca->shannon_entropy = READ_ONCE(e->entropy);
+		ca->is_noise = READ_ONCE(e->state) == ENTE_STATE_NOISE;
+		ca->is_congestion = READ_ONCE(e->state) == ENTE_STATE_CONGESTION;
+		ca->has_entropy_data = 1;
+		ca->confidence = 1;
+		ca->tracking = 1;
+		
+		if (READ_ONCE(e->ssthresh)) {
+			ca->ssthresh = READ_ONCE(e->ssthresh);
+			tp->snd_ssthresh = ca->ssthresh;
+		}
+		ENTE_TCP_INC_STATS(sk, ENTE_STAT_CACHE_HITS);
+	}
+	rcu_read_unlock();
+}
+
+/* Warm start: remember what a closing flow learned about its path
+ * 
+ * The cache is bounded by cache_size. Expired entries in the target
+ * bucket are dropped on the way; when full, the oldest entry of the
+ * bucket is recycled, or the update is skipped if the bucket is empty.
+ */
+static void ente_tcp_cache_store(struct sock *sk, const struct ente_tcp *ca)
+{
+	struct ente_tcp_net *tn = net_generic(sock_net(sk), ente_tcp_net_id);
+	struct ente_tcp_cache_entry *e, *oldest = NULL;
+	struct hlist_node *tmp;
+	struct ente_tcp_dst dst;
+	u32 bucket;
+	
+	/* A flow that only replayed a seeded entry has nothing new: storing
+	 * it back would refresh the stamp and keep a stale entry alive past
+	 * cache_ttl through a stream of short connections
+	 */
+	if (!READ_ONCE(cache_size) || !ca->has_entropy_data ||
+	    !ca->classified || ca->min_rtt_us == U32_MAX ||
+	    !ente_tcp_cache_key(sk, &dst))
+		return;
+	
+	bucket = ente_tcp_cache_hash(&dst);
+	
+	spin_lock_bh(&tn->cache_lock);
+	e = ente_tcp_cache_find(tn, &dst);
+	if (!e) {
+		hlist_for_each_entry_safe(e, tmp, &tn->cache[bucket], node) {
+			if (ente_tcp_cache_expired(e))
+				ente_tcp_cache_unlink(tn, e);
+			else if (!oldest || time_before(e->stamp, oldest->stamp))
+				oldest = e;
+		}
+		
+		if (tn->cache_count >= READ_ONCE(cache_size)) {
+			if (!oldest)
+				goto out;
+			ente_tcp_cache_unlink(tn, oldest);
+		}
+		
+		e = kzalloc(sizeof(*e), GFP_ATOMIC | __GFP_NOWARN);
+		if (!e)
+			goto out;
+		e->dst = dst;
+		hlist_add_head_rcu(&e->node, &tn->cache[bucket]);
+		tn->cache_count++;
+	}
+	
+	WRITE_ONCE(e->min_rtt_us, ca->min_rtt_us);
+	WRITE_ONCE(e->ssthresh,
+		   ca->ssthresh < TCP_INFINITE_SSTHRESH ? ca->ssthresh : 0);
+	WRITE_ONCE(e->entropy, ca->shannon_entropy);
+	WRITE_ONCE(e->state, ente_tcp_get_state(ca));
+	WRITE_ONCE(e->stamp, jiffies);
+out:
+	spin_unlock_bh(&tn->cache_lock);
+}
+
+/* Bottleneck bandwidth: windowed max of the delivery rate */
+static u32 ente_tcp_max_bw(const struct ente_tcp *ca)
+{
+	return max(ca->bw_max_cur, ca->bw_max_prev);
+}
+
+/* Bandwidth-delay product in packets, 0 while there is no estimate */
+static u32 ente_tcp_bdp(const struct ente_tcp *ca)
+{
+	if (ca->min_rtt_us == U32_MAX)
+		return 0;
+	
+	return (u32)(((u64)ente_tcp_max_bw(ca) * ca->min_rtt_us) >> BW_SCALE);
+}
+
+/* Feed one rate_sample into the bandwidth max filter
+ * 
+ * Application-limited samples underestimate the path, so like BBR they
+ * only count when they raise the estimate.
+ */
+static void ente_tcp_update_bw(struct ente_tcp *ca, const struct rate_sample *rs)
+{
+	u64 bw;
+	
+	if (rs->delivered < 0 || rs->interval_us <= 0)
+		return;
+	
+	bw = div64_long((u64)rs->delivered * BW_UNIT, rs->interval_us);
+	bw = min_t(u64, bw, U32_MAX);
+	
+	if (rs->is_app_limited && bw < ente_tcp_max_bw(ca))
+		return;
+	
+	if (bw > ca->bw_max_cur)
+		ca->bw_max_cur = (u32)bw;
+}
+
+/* Model-based congestion avoidance (ente_tcp_bdp)
+ * 
+ * Instead of additive increase, move cwnd straight towards gain x BDP,
+ * which fills a high-BDP pipe within a round or two. The gain comes from
+ * the entropy classification. Returns false while there is no estimate,
+ * the caller then falls back to the entropy-aware additive increase.
+ * 
+ * A gain above 1 keeps a standing queue of (gain - 1) x BDP, so the flow
+ * would never see the path's real minimum RTT. While an expired min_rtt
+ * is re-measured (ca->min_rtt_probe), cwnd drops to half the BDP, as in
+ * BBR's PROBE_RTT, so the queue drains before the measured round; it
+ * climbs back by acked per ACK, within a round or two.
+ */
+static bool ente_tcp_bdp_cwnd(struct sock *sk, u32 acked)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	const struct ente_tcp *ca = inet_csk_ca(sk);
+	u32 bdp = ente_tcp_bdp(ca);
+	u32 gain = BDP_NEUTRAL_GAIN;
+	u64 target;
+	
+	if (!bdp)
+		return false;
+	
+	if (ca->min_rtt_probe)
+		gain = BDP_PROBE_GAIN;
+	else if (ca->has_entropy_data && ca->is_noise)
+		gain = BDP_NOISE_GAIN;
+	else if (ca->has_entropy_data && ca->is_congestion)
+		gain = BDP_CONGESTION_GAIN;
+	
+	target = max_t(u64, div_u64((u64)bdp * gain, 100), BDP_MIN_CWND);
+	target = min_t(u64, target, tp->snd_cwnd_clamp);
+	tp->snd_cwnd = (u32)min_t(u64, tp->snd_cwnd + acked, target);
+	return true;
+}
+
+/* Noise mode grows faster than Reno, but beyond a multiple of the BDP
+ * extra cwnd only fills the buffer of a noisy, deep-buffered link and
+ * inflates the RTT for everyone sharing it. Returns true when the flow is
+ * at the cap and must not grow; logs (rate limited) when the cap engages.
+ */
+static bool ente_tcp_noise_capped(struct sock *sk, struct ente_tcp *ca)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	u32 cap = READ_ONCE(noise_bdp_cap);
+	u32 bdp, limit;
+	
+	bdp = cap ? ente_tcp_bdp(ca) : 0;
+	if (!bdp) {
+		ca->bdp_capped = 0;
+		return false;
+	}
+	
+	limit = (u32)max_t(u64, div_u64((u64)bdp * cap, 100), BDP_MIN_CWND);
+	if (tp->snd_cwnd < limit) {
+		ca->bdp_capped = 0;
+		return false;
+	}
+	
+	if (!ca->bdp_capped) {
+		ca->bdp_capped = 1;
+		ENTE_TCP_INC_STATS(sk, ENTE_STAT_BDP_CAPPED);
+		net_info_ratelimited("ENTE-TCP: port %u->%u noise growth capped at cwnd %u (BDP %u, min RTT %u us)\n",
+				     sk->sk_num, ntohs(sk->sk_dport),
+				     tp->snd_cwnd, bdp, ca->min_rtt_us);
+	}
+	return true;
+}
+
+/* ECN: fold the finished round into alpha (DCTCP update rule)
+ * 
+ * alpha = (1 - g) * alpha + g * F, F = CE-marked / delivered this round
+ * 
+ * Called from __ente_tcp_cong_control() on every ACK, in any ca_state:
+ * cong_avoid does not run in CWR or Recovery, where steady L4S marking
+ * keeps the flow. A round ends, as in BBR, once a packet sent after the
+ * previous boundary (ecn_delivered) is delivered.
+ */
+static void ente_tcp_ecn_round(const struct tcp_sock *tp, struct ente_tcp *ca)
+{
+	u32 delivered = tp->delivered - ca->ecn_delivered;
+	u32 delivered_ce = tp->delivered_ce - ca->ecn_delivered_ce;
+	u32 alpha = ca->ecn_alpha;
+	
+	alpha -= min_not_zero(alpha, alpha >> ECN_ALPHA_SHIFT);
+	if (delivered && delivered_ce)
+		alpha += (min(delivered_ce, delivered) <<
+			  (10 - ECN_ALPHA_SHIFT)) / delivered;
+	
+	ca->ecn_alpha = min_t(u32, alpha, ECN_ALPHA_MAX);
+	ca->ecn_delivered = tp->delivered;
+	ca->ecn_delivered_ce = tp->delivered_ce;
+	ca->ecn_ce_round = 0;
+}
+
+/* ECN: ground truth that overrides the entropy guess
+ * 
+ * CE marks mean a queue at an AQM bottleneck, so any marking makes the
+ * state congestion even if the RTT pattern looks like noise. Conversely,
+ * on a path that has been seen to mark, a clean alpha means there is no
+ * queue: a congestion verdict from entropy is relaxed to neutral.
+ */
+static void ente_tcp_ecn_classify(const struct tcp_sock *tp, struct ente_tcp *ca)
+{
+	if (!(tp->ecn_flags & TCP_ECN_OK) || !ca->ecn_marking)
+		return;
+	
+	if (ca->ecn_ce_round || ca->ecn_alpha >= ECN_ALPHA_CLEAN) {
+		ca->is_noise = 0;
+		ca->is_congestion = 1;
+	} else if (ca->is_congestion) {
+		ca->is_congestion = 0;
+	}
+}
+
+/* Initialize ENTE-TCP on new connection */
+static void ente_tcp_init(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct ente_tcp *ca = inet_csk_ca(sk);
+	
+	/* Initialize state */
+	ca->min_rtt_us = U32_MAX;
+	ca->min_rtt_stamp = tcp_jiffies32;
+	ca->min_rtt_probe = 0;
+	ca->ssthresh = tp->snd_ssthresh;
+	ca->history_index = 0;
+	ca->history_count = 0;
+	ca->shannon_entropy = 0;
+	ca->packets_acked = 0;
+	ca->rtt_variance = 0;
+	ca->avg_rtt_us = 0;
+	ca->round_end_seq = tp->snd_nxt;
+	ca->round_count = 0;
+	ca->round_min_rtt_us = U32_MAX;
+	ca->round_samples = 0;
+	ca->bw_max_cur = 0;
+	ca->bw_max_prev = 0;
+	ca->bw_round = 0;
+	ca->ecn_delivered = tp->delivered;
+	ca->ecn_delivered_ce = tp->delivered_ce;
+	ca->ecn_alpha = 0;
+	ca->ext = NULL;
+	ca->loss_episodes = 0;
+	ca->undo_events = 0;
+	ca->reord_seen = (u8)tp->reord_seen;
+	ca->recovery_state = ENTE_STATE_NEUTRAL;
+	ca->event_state = ENTE_STATE_NEUTRAL;
+	ca->classified = 0;
+	ca->ack_una = 0;
+	ca->ack_ece = 0;
+	
+	/* Clear flags */
+	ca->has_entropy_data = 0;
+	ca->in_slow_start = 1;
+	ca->is_noise = 0;
+	ca->is_congestion = 0;
+	ca->loss_event = 0;
+	ca->tracking = 0;
+	ca->ecn_ce_round = 0;
+	ca->ecn_marking = 0;
+	ca->bdp_capped = 0;
+	ca->is_periodic = 0;
+	ca->confidence = 0;
+	
+	/* Clear RTT history */
+	memset(ca->rtt_history, 0, sizeof(ca->rtt_history));
+	
+	/* Start with infinite ssthresh (standard behavior) */
+	tp->snd_ssthresh = TCP_INFINITE_SSTHRESH;
+	
+	/* Pacing-capable: ente_tcp_update_pacing_rate() owns sk_pacing_rate */
+	if (pacing)
+		cmpxchg(&sk->sk_pacing_status, SK_PACING_NONE, SK_PACING_NEEDED);
+	
+	/* Reuse what a recent flow learned about this destination */
+	ente_tcp_cache_seed_flow(sk, ca);
+	
+	ENTE_TCP_INC_STATS(sk, ENTE_STAT_FLOWS_NEUTRAL + ente_tcp_get_state(ca));
+}
+
+/* L4S variant: alpha drives every ECN response, so it is maintained from
+ * the first round (no short-flow fast path) and starts at 1.0, giving a
+ * classic halving until real marking statistics exist. Without ECN the
+ * flow behaves exactly like ente_tcp.
+ */
+static void ente_tcp_l4s_init(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct ente_tcp *ca = inet_csk_ca(sk);
+	
+	ente_tcp_init(sk);
+	
+	if (tp->ecn_flags & TCP_ECN_OK) {
+		ca->tracking = 1;
+		ca->ecn_alpha = L4S_ALPHA_INIT;
+	}
+}
+
+/* Count a loss episode for the spurious-loss rate. Both counts are halved
+ * every SPURIOUS_WINDOW episodes, so the rate follows the current path.
+ */
+static void ente_tcp_count_loss(struct ente_tcp *ca)
+{
+	if (++ca->loss_episodes >= SPURIOUS_WINDOW) {
+		ca->loss_episodes >>= 1;
+		ca->undo_events >>= 1;
+	}
+}
+
+/* At least half of the recent losses were undone: evidence of noise */
+static bool ente_tcp_mostly_spurious(const struct ente_tcp *ca)
+{
+	return ca->loss_episodes >= SPURIOUS_MIN_EPISODES &&
+	       ca->undo_events * 2 >= ca->loss_episodes;
+}
+
+/* Classification events: one multicast group, per-netns delivery */
+enum {
+	ENTE_TCP_MCGRP_EVENTS,
+};
+
+static const struct genl_multicast_group ente_tcp_genl_mcgrps[] = {
+	[ENTE_TCP_MCGRP_EVENTS] = {
+		.name = ENTE_TCP_GENL_MCGRP_EVENTS,
+#ifdef GENL_MCAST_CAP_NET_ADMIN
+		/* Events carry addresses and ports of other users' flows */
+		.flags = GENL_MCAST_CAP_NET_ADMIN,
+#endif
+	},
+};
+
+static struct genl_family ente_tcp_genl_family __ro_after_init = {
+	.name		= ENTE_TCP_GENL_NAME,
+	.version	= ENTE_TCP_GENL_VERSION,
+	.maxattr	= ENTE_TCP_ATTR_MAX,
+	.netnsok	= true,
+	.module		= THIS_MODULE,
+	.mcgrps		= ente_tcp_genl_mcgrps,
+	.n_mcgrps	= ARRAY_SIZE(ente_tcp_genl_mcgrps),
+};
+
+static u64 ente_tcp_cgroup_id(struct sock *sk)
+{
+#ifdef CONFIG_SOCK_CGROUP_DATA
+	return cgroup_id(sock_cgroup_ptr(&sk->sk_cgrp_data));
+#else
+	return 0;
+#endif
+}
+
+/* event_port and event_cgroup filters; a cgroup matches its whole subtree */
+static bool ente_tcp_event_match(struct sock *sk)
+{
+	u16 port = READ_ONCE(event_port);
+	u64 id = READ_ONCE(event_cgroup);
+	
+	if (port && port != ntohs(inet_sk(sk)->inet_sport) &&
+	    port != ntohs(inet_sk(sk)->inet_dport))
+		return false;
+	
+#ifdef CONFIG_SOCK_CGROUP_DATA
+	if (id) {
+		struct cgroup *cgrp = sock_cgroup_ptr(&sk->sk_cgrp_data);
+		
+		for (; cgrp; cgrp = cgroup_parent(cgrp))
+			if (cgroup_id(cgrp) == id)
+				return true;
+		return false;
+	}
+#endif
+	return true;
+}
+
+/* Exact payload of one event, so softirq allocates ~150 bytes, not a page */
+static size_t ente_tcp_event_size(const struct sock *sk,
+				  const struct ente_tcp *ca)
+{
+	size_t addr = sizeof(__be32), size;
+	
+#if IS_ENABLED(CONFIG_IPV6)
+	if (sk->sk_family == AF_INET6 && !ipv6_addr_v4mapped(&sk->sk_v6_daddr))
+		addr = sizeof(struct in6_addr);
+#endif
+	size = nla_total_size(sizeof(u8)) +         /* FAMILY */
+	       2 * nla_total_size(addr) +             /* SADDR, DADDR */
+	       2 * nla_total_size(sizeof(u16)) +      /* SPORT, DPORT */
+	       nla_total_size_64bit(sizeof(u64)) +    /* CGROUP */
+	       2 * nla_total_size(sizeof(u8)) +       /* OLD_STATE, NEW_STATE */
+	       nla_total_size(sizeof(u16)) +          /* ENTROPY */
+	       2 * nla_total_size(sizeof(u32));       /* SRTT_US, CWND */
+	if (ca->ext)
+		size += nla_total_size_64bit(sizeof(u64)) + /* HISTORY */
+			3 * nla_total_size(sizeof(u32));    /* *_COUNT */
+	return size;
+}
+
+static int ente_tcp_event_fill(struct sk_buff *skb, struct sock *sk,
+			       const struct ente_tcp *ca,
+			       enum ente_tcp_state state)
+{
+	const struct inet_sock *inet = inet_sk(sk);
+	const struct tcp_sock *tp = tcp_sk(sk);
+	const struct ente_tcp_ext *ext = ca->ext;
+	
+#if IS_ENABLED(CONFIG_IPV6)
+	if (sk->sk_family == AF_INET6 && !ipv6_addr_v4mapped(&sk->sk_v6_daddr)) {
+		if (nla_put_u8(skb, ENTE_TCP_ATTR_FAMILY, AF_INET6) ||
+		    nla_put_in6_addr(skb, ENTE_TCP_ATTR_SADDR,
+				     &sk->sk_v6_rcv_saddr) ||
+		    nla_put_in6_addr(skb, ENTE_TCP_ATTR_DADDR, &sk->sk_v6_daddr))
+			return -EMSGSIZE;
+	} else
+#endif
+	if (nla_put_u8(skb, ENTE_TCP_ATTR_FAMILY, AF_INET) ||
+	    nla_put_in_addr(skb, ENTE_TCP_ATTR_SADDR, inet->inet_saddr) ||
+	    nla_put_in_addr(skb, ENTE_TCP_ATTR_DADDR, inet->inet_daddr))
+		return -EMSGSIZE;
+	
+	if (nla_put_u16(skb, ENTE_TCP_ATTR_SPORT, ntohs(inet->inet_sport)) ||
+	    nla_put_u16(skb, ENTE_TCP_ATTR_DPORT, ntohs(inet->inet_dport)) ||
+	    nla_put_u64_64bit(skb, ENTE_TCP_ATTR_CGROUP, ente_tcp_cgroup_id(sk),
+			      ENTE_TCP_ATTR_PAD) ||
+	    nla_put_u8(skb, ENTE_TCP_ATTR_OLD_STATE, ca->event_state) ||
+	    nla_put_u8(skb, ENTE_TCP_ATTR_NEW_STATE, state) ||
+	    nla_put_u16(skb, ENTE_TCP_ATTR_ENTROPY, ca->shannon_entropy) ||
+	    nla_put_u32(skb, ENTE_TCP_ATTR_SRTT_US, tp->srtt_us >> 3) ||
+	    nla_put_u32(skb, ENTE_TCP_ATTR_CWND, tp->snd_cwnd))
+		return -EMSGSIZE;
+	
+	/* Decision history, for telling a flapping flow from a settled one */
+	if (ext &&
+	    (nla_put_u64_64bit(skb, ENTE_TCP_ATTR_HISTORY,
+			       ext->decision_history, ENTE_TCP_ATTR_PAD) ||
+	     nla_put_u32(skb, ENTE_TCP_ATTR_NEUTRAL_COUNT,
+			 ext->decision_count[ENTE_STATE_NEUTRAL]) ||
+	     nla_put_u32(skb, ENTE_TCP_ATTR_NOISE_COUNT,
+			 ext->decision_count[ENTE_STATE_NOISE]) ||
+	     nla_put_u32(skb, ENTE_TCP_ATTR_CONGESTION_COUNT,
+			 ext->decision_count[ENTE_STATE_CONGESTION])))
+		return -EMSGSIZE;
+	return 0;
+}
+
+/* Tell userspace the flow changed state. At most one event per flow every
+ * event_interval_ms: a change inside the interval stays pending and goes
+ * out at the first entropy update after it, unless the flow has changed
+ * back by then. The stamp lives in the extended state, so short flows
+ * without it are not rate limited; they only last a few rounds. Flows
+ * nobody listens to or that are filtered out are marked as reported, so
+ * they only cost the state comparison.
+ */
+static noinline void ente_tcp_notify(struct sock *sk, struct ente_tcp *ca,
+				     enum ente_tcp_state state)
+{
+	struct net *net = sock_net(sk);
+	u32 now = tcp_jiffies32;
+	struct sk_buff *skb;
+	void *hdr;
+	
+	if (ca->ext && now - ca->ext->event_stamp <
+		       msecs_to_jiffies(event_interval_ms))
+		return;
+	
+	if (!genl_has_listeners(&ente_tcp_genl_family, net,
+				ENTE_TCP_MCGRP_EVENTS) ||
+	    !ente_tcp_event_match(sk))
+		goto out;
+	
+	skb = genlmsg_new(ente_tcp_event_size(sk, ca), GFP_ATOMIC);
+	if (!skb)
+		return;
+	
+	hdr = genlmsg_put(skb, 0, 0, &ente_tcp_genl_family, 0,
+			  ENTE_TCP_CMD_STATE_CHANGE);
+	if (!hdr || ente_tcp_event_fill(skb, sk, ca, state)) {
+		nlmsg_free(skb);
+		return;
+	}
+	genlmsg_end(skb, hdr);
+	genlmsg_multicast_netns(&ente_tcp_genl_family, net, skb, 0,
+				ENTE_TCP_MCGRP_EVENTS, GFP_ATOMIC);
+	
+	if (ca->ext)
+		ca->ext->event_stamp = now;
+	ENTE_TCP_INC_STATS(sk, ENTE_STAT_EVENTS);
+out:
+	ca->event_state = state;
+}
+
+/* Additive increase at @gain / 1000 of Reno's rate
+ * 
+ * tcp_cong_avoid_ai() adds acked / w per ACK, so the gain shrinks or grows
+ * w instead of being applied to a per-ACK increment that would round to
+ * zero. Profiles with rtt0_ms also multiply the rate by rho^2, rho =
+ * srtt / rtt0 (Hybla), so a long-RTT flow grows per second like one with
+ * RTT rtt0.
+ */
+static __always_inline void ente_tcp_ai(struct sock *sk, u32 acked, u32 gain,
+					const struct ente_tcp_profile *p)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 rho8, w;
+	
+	if (!tcp_is_cwnd_limited(sk))
+		return;
+	
+	if (p->rtt0_ms) {
+		/* srtt_us is x8, so this is rho x8 */
+		rho8 = clamp_t(u32, tp->srtt_us / (p->rtt0_ms * USEC_PER_MSEC),
+			       8, HYBLA_RHO_MAX << 3);
+		gain = (gain * rho8 * rho8) >> 6;
+	}
+	
+	w = max_t(u32, div_u64((u64)tp->snd_cwnd * 1000, gain), 1);
+	tcp_cong_avoid_ai(tp, w, acked);
+}
+
+/* Main congestion control logic - called on each ACK
+ * 
+ * @p is a compile-time constant profile. ente_tcp_bdp replaces additive
+ * increase with a cwnd target once a bandwidth estimate exists;
+ * ente_tcp_l4s keeps CE marks out of the classification, since on an L4S
+ * path they are the normal per-round control signal, not congestion.
+ */
+static __always_inline void ente_tcp_cong_avoid(struct sock *sk, u32 ack,
+						u32 acked,
+						const struct ente_tcp_profile *p)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct ente_tcp *ca = inet_csk_ca(sk);
+	u32 rtt_us, rtt_ms;
+	
+	if (!acked)
+		return;
+	
+	/* Short-flow fast path: most connections finish in initial slow start
+	 * before any entropy could be computed, so run plain Reno and skip
+	 * all bookkeeping until the flow proves to be long enough.
+	 */
+	if (!ca->tracking) {
+		if (tp->snd_cwnd < tp->snd_ssthresh &&
+		    tp->bytes_acked < fastpath_bytes) {
+			tcp_reno_cong_avoid(sk, ack, acked);
+			return;
+		}
+		
+		/* Start tracking: the first round begins now */
+		ca->tracking = 1;
+		ca->round_end_seq = tp->snd_nxt;
+	}
+	
+	/* Update packet counter */
+	ca->packets_acked += acked;
+	
+	/* Round trip boundary: the first packet of the last round is acked */
+	if (after(ack, ca->round_end_seq)) {
+		ca->round_end_seq = tp->snd_nxt;
+		if (ca->round_count < U16_MAX)
+			ca->round_count++;
+		
+		/* Expired min_rtt: the round just measured replaces it, unless
+		 * the flow sat at the noise cap and never saw below its own queue
+		 */
+		if (ca->min_rtt_probe && !--ca->min_rtt_probe) {
+			if (ca->round_min_rtt_us != U32_MAX && !ca->bdp_capped)
+				ca->min_rtt_us = ca->round_min_rtt_us;
+			ca->min_rtt_stamp = tcp_jiffies32;
+		}
+		ca->round_min_rtt_us = U32_MAX;
+		ca->round_samples = 0;
+		ca->reord_seen = (u8)tp->reord_seen;
+		
+		/* Age the bandwidth filter one sub-window at a time; its own
+		 * counter, as round_count stops at U16_MAX
+		 */
+		if (++ca->bw_round >= BW_FILTER_ROUNDS) {
+			ca->bw_max_prev = ca->bw_max_cur;
+			ca->bw_max_cur = 0;
+			ca->bw_round = 0;
+		}
+		
+		/* Long-lived flow: move on to the extended state; once there,
+		 * count rounds in it with a counter that wraps
+		 */
+		if (ca->ext)
+			ca->ext->round++;
+		else
+			ente_tcp_ext_try_alloc(sk, ca,
+					       p->window > ENTROPY_WINDOW_SIZE);
+	}
+	
+	/* Get current smoothed RTT */
+	rtt_us = tp->srtt_us >> 3; /* srtt_us is scaled by 8 */
+	if (rtt_us == 0)
+		rtt_us = 1;
+	
+	/* Convert to milliseconds for storage (saves memory) */
+	rtt_ms = min_t(u32, rtt_us / 1000, 65535);
+	if (rtt_ms == 0)
+		rtt_ms = 1;
+	
+	/* Store RTT in circular history buffer */
+	ca->rtt_history[ca->history_index] = (u16)rtt_ms;
+	ca->history_index = (ca->history_index + 1) % ENTROPY_WINDOW_SIZE;
+	if (ca->history_count < ENTROPY_WINDOW_SIZE)
+		ca->history_count++;
+	
+	if (ca->ext)
+		ente_tcp_ext_add_sample(ca->ext, (u16)rtt_ms);
+	
+	/* Route change or handover: the history describes the old path.
+	 * The reset leaves one sample, so entropy waits for the new path.
+	 */
+	if (ca->packets_acked >= ENTROPY_CALC_INTERVAL &&
+	    ca->history_count >= ENTROPY_MIN_SAMPLES &&
+	    ca->ext && change_detect) {
+		enum ente_tcp_shift shift = ente_tcp_path_changed(sk, ca, rtt_us);
+		
+		if (shift != ENTE_SHIFT_NONE)
+			ente_tcp_path_reset(sk, ca, shift);
+	}
+	
+	/* Calculate entropy periodically (not every packet for efficiency) */
+	if (ca->packets_acked >= ENTROPY_CALC_INTERVAL &&
+	    ca->history_count >= ENTROPY_MIN_SAMPLES) {
+		enum ente_tcp_state prev = ente_tcp_get_state(ca), state;
+		
 		/* Calculate Shannon entropy from RTT distribution */
-		ca->shannon_entropy = (u16)calculate_entropy(ca);
+		if (p->window) {
+			ca->shannon_entropy = ente_tcp_window_entropy(ca,
+								      p->window);
+		} else {
+			ca->shannon_entropy = (u16)calculate_entropy(ca->rtt_history,
+								     ENTROPY_WINDOW_SIZE,
+								     ca->history_index,
+								     ca->history_count);
+			
+			/* Long-lived flows: use the longer extended window */
+			if (ca->ext)
+				ca->shannon_entropy = ente_tcp_ext_entropy(ca->ext,
+									   ca->shannon_entropy);
+		}
 		
 		/* Update RTT statistics */
 		update_rtt_stats(ca);
@@ -249,26 +2021,57 @@ static void ente_tcp_cong_avoid(struct sock *sk, u32 ack, u32 acked)
 		/* Reset packet counter */
 		ca->packets_acked = 0;
 		ca->has_entropy_data = 1;
+		ca->classified = 1;
+		ca->confidence = CONFIDENCE_MAX;
 		
 		/* Classify network condition based on entropy */
-		if (ca->shannon_entropy > HIGH_ENTROPY_THRESHOLD) {
+		ca->is_periodic = periodicity && ente_tcp_periodic(ca);
+		if (ca->is_periodic) {
+			/* Periodic RTT = link scheduling (TTI, DRX), not a
+			 * queue: whatever the entropy, stay neutral unless
+			 * losses keep turning out spurious
+			 */
+			ENTE_TCP_INC_STATS(sk, ENTE_STAT_PERIODIC);
+			ca->is_noise = ente_tcp_mostly_spurious(ca);
+			ca->is_congestion = 0;
+		} else if (ca->shannon_entropy > p->high_entropy) {
 			/* High entropy = random RTT variation = likely noise
 			 * Examples: WiFi interference, mobile handoff, wireless jitter
 			 */
 			ca->is_noise = 1;
 			ca->is_congestion = 0;
-		} else if (ca->shannon_entropy < LOW_ENTROPY_THRESHOLD) {
+		} else if (ca->shannon_entropy < p->low_entropy) {
 			/* Low entropy = consistent RTT increase = likely congestion
 			 * Examples: Queue buildup, bandwidth saturation
 			 */
 			ca->is_noise = 0;
 			ca->is_congestion = 1;
 		} else {
-			/* Medium entropy = unclear, be neutral */
-			ca->is_noise = 0;
+			/* Medium entropy = unclear: noise if recent losses
+			 * keep turning out spurious, otherwise be neutral
+			 */
+			ca->is_noise = ente_tcp_mostly_spurious(ca);
 			ca->is_congestion = 0;
 		}
 		
+		/* ECN marks, where available, decide */
+		if (p->mode != ENTE_MODE_L4S)
+			ente_tcp_ecn_classify(tp, ca);
+		
+		state = ente_tcp_get_state(ca);
+		if (ca->ext)
+			ente_tcp_ext_record(ca->ext, state);
+		
+		ENTE_TCP_INC_STATS(sk, ENTE_STAT_ENTROPY_UPDATES);
+		ente_tcp_hist_record(sk, ca->shannon_entropy, ca->rtt_variance);
+		if (state != prev) {
+			ENTE_TCP_DEC_STATS(sk, ENTE_STAT_FLOWS_NEUTRAL + prev);
+			ENTE_TCP_INC_STATS(sk, ENTE_STAT_FLOWS_NEUTRAL + state);
+			ENTE_TCP_INC_STATS(sk, ENTE_STAT_STATE_CHANGES);
+		}
+		if (state != ca->event_state)
+			ente_tcp_notify(sk, ca, state);
+		
 		/* Clear loss flag after analysis */
 		ca->loss_event = 0;
 	}
@@ -289,9 +2092,11 @@ static void ente_tcp_cong_avoid(struct sock *sk, u32 ack, u32 acked)
 			
 		} else if (ca->has_entropy_data && ca->is_noise) {
 			/* Detected noise: maintain aggressive growth
-			 * This is just random variation, not congestion
+			 * This is just random variation, not congestion,
+			 * but stop at the BDP cap
 			 */
-			tcp_slow_start(tp, acked);
+			if (!ente_tcp_noise_capped(sk, ca))
+				tcp_slow_start(tp, acked);
 			
 		} else {
 			/* Normal slow start (not enough data yet) */
@@ -301,82 +2106,520 @@ static void ente_tcp_cong_avoid(struct sock *sk, u32 ack, u32 acked)
 	} else {
 		/* CONGESTION AVOIDANCE PHASE: Linear growth */
 		
-		if (ca->has_entropy_data && ca->is_congestion) {
-			/* Real congestion detected: be conservative
-			 * Grow slowly: cwnd += 0.5 * acked / cwnd
-			 */
-			u32 delta = max(1U, (acked * CONGESTION_CONSERVE) / 
-			                (tp->snd_cwnd * 1000));
-			tcp_cong_avoid_ai(tp, tp->snd_cwnd, delta);
-			
-		} else if (ca->has_entropy_data && ca->is_noise) {
-			/* Noise detected: be aggressive
-			 * Grow faster: cwnd += 1.5 * acked / cwnd
-			 */
-			u32 delta = max(1U, (acked * NOISE_AGGRESSION) / 
-			                (tp->snd_cwnd * 1000));
-			tcp_cong_avoid_ai(tp, tp->snd_cwnd, delta);
-			
-		} else {
-			/* Not enough entropy data: use standard Reno behavior
-			 * cwnd += acked / cwnd
-			 */
-			tcp_reno_cong_avoid(sk, ack, acked);
-		}
+		if (p->mode == ENTE_MODE_BDP && ente_tcp_bdp_cwnd(sk, acked)) {
+			/* Model-based: cwnd follows gain x BDP */
+			
+		} else if (ca->has_entropy_data && ca->is_congestion) {
+			/* Real congestion detected: be conservative
+			 * Grow slowly: cwnd += 0.5 * acked / cwnd
+			 */
+			ente_tcp_ai(sk, acked, p->congestion_conserve, p);
+			
+		} else if (ca->has_entropy_data && ca->is_noise) {
+			/* Noise detected: be aggressive
+			 * Grow faster: cwnd += 1.5 * acked / cwnd,
+			 * up to the BDP cap
+			 */
+			if (!ente_tcp_noise_capped(sk, ca))
+				ente_tcp_ai(sk, acked, p->noise_aggression, p);
+			
+		} else if (p->rtt0_ms) {
+			/* Long-RTT profile: Reno's rate, scaled by RTT */
+			ente_tcp_ai(sk, acked, 1000, p);
+			
+		} else {
+			/* Not enough entropy data: use standard Reno behavior
+			 * cwnd += acked / cwnd
+			 */
+			tcp_reno_cong_avoid(sk, ack, acked);
+		}
+	}
+}
+
+/* Release per-connection resources */
+static void ente_tcp_release(struct sock *sk)
+{
+	struct ente_tcp *ca = inet_csk_ca(sk);
+	
+	ente_tcp_cache_store(sk, ca);
+	ENTE_TCP_DEC_STATS(sk, ENTE_STAT_FLOWS_NEUTRAL + ente_tcp_get_state(ca));
+	
+	if (ca->ext) {
+		kmem_cache_free(ente_tcp_ext_cachep, ca->ext);
+		ca->ext = NULL;
+	}
+}
+
+/* Slow start exit check
+ * 
+ * Delay increase: the minimum RTT of this round's first samples exceeds
+ * the windowed minimum RTT by min_rtt/8 (bounded to 4-16 ms), i.e. a
+ * queue is forming. On a path classified as noise this is likely jitter,
+ * so slow start goes on; on a congestion-classified path the threshold
+ * is halved to leave even earlier. Exiting sets ssthresh = cwnd so the
+ * first overshoot loss never happens.
+ */
+static void ente_tcp_hystart_update(struct sock *sk, struct ente_tcp *ca)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	u32 thresh;
+	
+	if (ca->has_entropy_data && ca->is_noise)
+		return;
+	
+	if (ca->min_rtt_us == U32_MAX || tp->snd_cwnd < hystart_low_window)
+		return;
+	
+	thresh = clamp(ca->min_rtt_us >> 3, HYSTART_DELAY_MIN, HYSTART_DELAY_MAX);
+	if (ca->has_entropy_data && ca->is_congestion)
+		thresh >>= 1;
+	
+	if (ca->round_min_rtt_us >= ca->min_rtt_us + thresh) {
+		tp->snd_ssthresh = tp->snd_cwnd;
+		ca->ssthresh = tp->snd_cwnd;
+		ca->in_slow_start = 0;
+	}
+}
+
+/* Baseline: windowed minimum of raw RTT samples
+ * 
+ * srtt carries any standing queue, so it must not feed the baseline: each
+ * window would restart from a higher value. When the window expires the
+ * old minimum stays in use while one full round is measured, see the
+ * round boundary in ente_tcp_cong_avoid().
+ */
+static void ente_tcp_update_min_rtt(struct ente_tcp *ca, u32 rtt_us)
+{
+	if (rtt_us < ca->min_rtt_us) {
+		ca->min_rtt_us = rtt_us;
+		ca->min_rtt_stamp = tcp_jiffies32;
+	}
+	
+	if (ca->min_rtt_probe)
+		ca->round_min_rtt_us = min(ca->round_min_rtt_us, rtt_us);
+	else if (ca->tracking &&
+		 time_after32(tcp_jiffies32,
+			      ca->min_rtt_stamp + MIN_RTT_WIN_SEC * HZ))
+		ca->min_rtt_probe = MIN_RTT_PROBE_ROUNDS;
+}
+
+/* Per-ACK RTT samples (raw, unlike srtt): min_rtt and slow start exit */
+static void ente_tcp_pkts_acked(struct sock *sk, const struct ack_sample *sample)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	struct ente_tcp *ca = inet_csk_ca(sk);
+	
+	if (sample->pkts_acked)
+		ca->ack_una = 1;
+	
+	if (sample->rtt_us <= 0)
+		return;
+	
+	ente_tcp_update_min_rtt(ca, sample->rtt_us);
+	if (ca->ext && periodicity)
+		ente_tcp_periodic_sample(ca->ext, tp->tcp_mstamp,
+					 sample->rtt_us - ca->min_rtt_us);
+	
+	/* Short-flow fast path and congestion avoidance: nothing more to do */
+	if (!ca->tracking || !hystart || tp->snd_cwnd >= tp->snd_ssthresh)
+		return;
+	
+	if (ca->round_samples >= HYSTART_MIN_SAMPLES)
+		return;
+	
+	ca->round_min_rtt_us = min_t(u32, ca->round_min_rtt_us, sample->rtt_us);
+	if (++ca->round_samples == HYSTART_MIN_SAMPLES)
+		ente_tcp_hystart_update(sk, ca);
+}
+
+/* Pacing rate: gain x cwnd / srtt, with the gain picked by phase and
+ * classification. Noise-mode growth is sent smoothly instead of in
+ * line-rate bursts that overflow shallow Wi-Fi buffers; congestion mode
+ * paces at the delivery rate so it does not grow the queue.
+ */
+static __always_inline void
+ente_tcp_update_pacing_rate(struct sock *sk, const struct ente_tcp_profile *p)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	const struct ente_tcp *ca = inet_csk_ca(sk);
+	bool congestion = ca->has_entropy_data && ca->is_congestion;
+	bool noise = ca->has_entropy_data && ca->is_noise;
+	u32 gain;
+	u64 rate;
+	
+	if (tp->snd_cwnd < tp->snd_ssthresh)
+		gain = congestion ? PACING_SS_CONGESTION_GAIN : PACING_SS_GAIN;
+	else if (congestion)
+		gain = PACING_CONGESTION_GAIN;
+	else if (noise)
+		gain = p->pacing_noise_gain;
+	else
+		gain = PACING_NEUTRAL_GAIN;
+	
+	/* Same fixed point as tcp_update_pacing_rate(): srtt_us is x8 */
+	rate = (u64)tp->mss_cache * ((USEC_PER_SEC / 100) << 3) * gain;
+	rate *= max(tp->snd_cwnd, tp->packets_out);
+	if (likely(tp->srtt_us))
+		do_div(rate, tp->srtt_us);
+	
+	WRITE_ONCE(sk->sk_pacing_rate,
+		   min_t(u64, rate, READ_ONCE(sk->sk_max_pacing_rate)));
+}
+
+/* Proportional Rate Reduction (RFC 6937) in CWR and Recovery
+ * 
+ * The kernel only runs tcp_cwnd_reduction() for algorithms without
+ * .cong_control, so this is the same computation done here. Without the
+ * kernel's "snd_una advanced" flag the optional extra segment of
+ * PRR-SSRB is left out, which errs on the conservative side.
+ */
+static void ente_tcp_cwnd_reduction(struct sock *sk, int newly_acked_sacked)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	int delta = tp->snd_ssthresh - tcp_packets_in_flight(tp);
+	int sndcnt;
+	
+	if (newly_acked_sacked <= 0 || !tp->prior_cwnd)
+		return;
+	
+	tp->prr_delivered += newly_acked_sacked;
+	if (delta < 0) {
+		u64 dividend = (u64)tp->snd_ssthresh * tp->prr_delivered +
+			       tp->prior_cwnd - 1;
+		sndcnt = div_u64(dividend, tp->prior_cwnd) - tp->prr_out;
+	} else {
+		sndcnt = max_t(int, tp->prr_delivered - tp->prr_out,
+			       newly_acked_sacked);
+		sndcnt = min(delta, sndcnt);
+	}
+	
+	/* Force a fast retransmit upon entering fast recovery */
+	sndcnt = max(sndcnt, (tp->prr_out ? 0 : 1));
+	tp->snd_cwnd = tcp_packets_in_flight(tp) + sndcnt;
+}
+
+/* Post-RTO restart policy, chosen by the verdict at Loss entry
+ * 
+ * The kernel restarts from cwnd = 1 after an RTO. After congestion (or
+ * without a clear verdict) slow start back to ssthresh is right. After
+ * noise the timeout more likely came from a link outage or a burst of
+ * random loss: once new data is acknowledged the path works again, so go
+ * straight back to ssthresh (the noise response, close to the BDP) and
+ * let pacing spread the burst.
+ */
+static void ente_tcp_rto_restart(struct sock *sk, const struct ente_tcp *ca)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	
+	if (ca->recovery_state != ENTE_STATE_NOISE ||
+	    sk->sk_pacing_status == SK_PACING_NONE ||
+	    tp->snd_cwnd >= tp->snd_ssthresh)
+		return;
+	
+	tp->snd_cwnd = min(tp->snd_ssthresh, tp->snd_cwnd_clamp);
+	tp->snd_cwnd_stamp = tcp_jiffies32;
+	ENTE_TCP_INC_STATS(sk, ENTE_STAT_RTO_RESTARTS);
+}
+
+/* Write one trace record for this ACK if the flow is sampled. Sampling
+ * by sk_hash keeps whole flows, so every traced flow can be replayed.
+ */
+static noinline void ente_tcp_trace(struct sock *sk,
+				    const struct rate_sample *rs)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	const struct ente_tcp *ca = inet_csk_ca(sk);
+	struct ente_tcp_trace_rec rec;
+	u32 sample = READ_ONCE(trace_sample);
+	
+	if (sample > 1 && reciprocal_scale(sk->sk_hash, sample))
+		return;
+	
+	rec.tstamp_us = tp->tcp_mstamp;
+	rec.flow_hash = sk->sk_hash;
+	rec.rtt_us = rs->rtt_us > 0 ? (u32)rs->rtt_us : 0;
+	rec.srtt_us = tp->srtt_us >> 3;
+	rec.cwnd = tp->snd_cwnd;
+	rec.acked = min_t(u32, rs->acked_sacked, U16_MAX);
+	rec.entropy = ca->shannon_entropy;
+	rec.state = ente_tcp_get_state(ca);
+	rec.ca_state = inet_csk(sk)->icsk_ca_state;
+	rec.reserved = 0;
+	
+	relay_write(ente_tcp_trace_chan, &rec, sizeof(rec));
+}
+
+/* Grow cwnd only on in-order delivery, as tcp_may_raise_cwnd() does: a
+ * SACK-only dupack (Disorder) or an ECN-Echo does not open the window.
+ * On a path known to reorder, any newly delivered data counts.
+ */
+static __always_inline bool ente_tcp_may_raise_cwnd(const struct sock *sk,
+						    const struct ente_tcp *ca,
+						    const struct rate_sample *rs)
+{
+	if (!rs->acked_sacked)
+		return false;
+	if (tcp_sk(sk)->reordering >
+	    READ_ONCE(sock_net(sk)->ipv4.sysctl_tcp_reordering))
+		return true;
+	return ca->ack_una && !ca->ack_ece;
+}
+
+/* Per-ACK control: replaces the kernel's tcp_cong_control() so that the
+ * pacing rate set here is not overwritten. Bandwidth sampling, then cwnd
+ * reduction during CWR and Recovery or growth otherwise, then pacing.
+ */
+static __always_inline void __ente_tcp_cong_control(struct sock *sk,
+						    const struct rate_sample *rs,
+						    const struct ente_tcp_profile *p)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct ente_tcp *ca = inet_csk_ca(sk);
+	
+	if ((tp->ecn_flags & TCP_ECN_OK) && rs->delivered > 0 &&
+	    !before(rs->prior_delivered, ca->ecn_delivered))
+		ente_tcp_ecn_round(tp, ca);
+	
+	/* Short flows skip sampling, like all other bookkeeping */
+	if (ca->tracking)
+		ente_tcp_update_bw(ca, rs);
+	if (ca->ext && rs->losses > 0)
+		ente_tcp_ext_loss(ca->ext, tp, rs->losses);
+	
+	if (tcp_in_cwnd_reduction(sk)) {
+		ente_tcp_cwnd_reduction(sk, rs->acked_sacked);
+	} else if (ente_tcp_may_raise_cwnd(sk, ca, rs)) {
+		u64 prof = ente_tcp_prof_start();
+		
+		if (inet_csk(sk)->icsk_ca_state == TCP_CA_Loss)
+			ente_tcp_rto_restart(sk, ca);
+		ente_tcp_cong_avoid(sk, tp->snd_una, rs->acked_sacked, p);
+		ente_tcp_prof_end(ENTE_PROF_CONG_AVOID, prof);
+		tp->snd_cwnd_stamp = tcp_jiffies32;
+	}
+	
+	ente_tcp_update_pacing_rate(sk, p);
+	
+	if (IS_ENABLED(CONFIG_RELAY) &&
+	    static_branch_unlikely(&ente_tcp_trace_key))
+		ente_tcp_trace(sk, rs);
+}
+
+/* .cong_control signature gained ack and flag in Linux 6.10 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+#define ENTE_CONG_CONTROL(fn) \
+	static void fn(struct sock *sk, u32 ack, int flag, \
+		       const struct rate_sample *rs)
+#else
+#define ENTE_CONG_CONTROL(fn) \
+	static void fn(struct sock *sk, const struct rate_sample *rs)
+#endif
+
+ENTE_CONG_CONTROL(ente_tcp_cong_control)
+{
+	__ente_tcp_cong_control(sk, rs, &ente_tcp_profile_default);
+}
+
+ENTE_CONG_CONTROL(ente_tcp_bdp_cong_control)
+{
+	__ente_tcp_cong_control(sk, rs, &ente_tcp_profile_bdp);
+}
+
+ENTE_CONG_CONTROL(ente_tcp_l4s_cong_control)
+{
+	__ente_tcp_cong_control(sk, rs, &ente_tcp_profile_l4s);
+}
+
+/* ACK processing events: record ECN-Echo as soon as it arrives. Called
+ * first on every ACK, so it also starts the per-ACK flags afresh.
+ */
+static void ente_tcp_in_ack_event(struct sock *sk, u32 flags)
+{
+	struct ente_tcp *ca = inet_csk_ca(sk);
+	
+	ca->ack_una = 0;
+	ca->ack_ece = !!(flags & CA_ACK_ECE);
+	if (flags & CA_ACK_ECE) {
+		ca->ecn_ce_round = 1;
+		ca->ecn_marking = 1;
 	}
 }
 
+/* Minimal reduction for losses that are not congestion
+ * 
+ * Keep what the path was delivering, Westwood+ style: ssthresh =
+ * BWE x min RTT, never above cwnd. Without an estimate yet, reduce less
+ * aggressively than Reno: cwnd * 2/3. The estimate can be far too low
+ * (an app-limited sample early in the flow, or just after a path reset
+ * cleared the filter), so it is floored at the congestion response: a
+ * noise loss never cuts deeper than a congestion loss.
+ */
+static __always_inline u32
+ente_tcp_noise_ssthresh(const struct tcp_sock *tp, const struct ente_tcp *ca,
+			const struct ente_tcp_profile *p)
+{
+	u32 bdp = ente_tcp_bdp(ca);
+	
+	if (bdp)
+		return max3(min(bdp, tp->snd_cwnd),
+			    tp->snd_cwnd / CONGESTION_REDUCTION_FACTOR, 2U);
+	
+	return max(tp->snd_cwnd - tp->snd_cwnd / p->noise_reduction, 2U);
+}
+
 /* Handle packet loss events - set slow start threshold */
-static u32 ente_tcp_ssthresh(struct sock *sk)
+static __always_inline u32 __ente_tcp_ssthresh(struct sock *sk,
+					       const struct ente_tcp_profile *p)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 	struct ente_tcp *ca = inet_csk_ca(sk);
-	u32 reduction_factor;
+	u64 prof = ente_tcp_prof_start();
+	u32 ssthresh;
 	
 	/* Mark loss event */
 	ca->loss_event = 1;
+	if (!ca->ecn_ce_round)
+		ente_tcp_count_loss(ca);
 	
 	/* Determine how much to reduce cwnd based on entropy */
-	if (ca->has_entropy_data) {
-		if (ca->is_noise) {
-			/* High entropy = likely noise (spurious loss)
-			 * Reduce less aggressively: cwnd * 2/3
-			 */
-			reduction_factor = NOISE_REDUCTION_FACTOR;
-			
-		} else if (ca->is_congestion) {
-			/* Low entropy = real congestion
-			 * Standard reduction: cwnd / 2
-			 */
-			reduction_factor = CONGESTION_REDUCTION_FACTOR;
-			
-		} else {
-			/* Medium entropy: standard reduction */
-			reduction_factor = CONGESTION_REDUCTION_FACTOR;
-		}
+	if (ca->ecn_ce_round) {
+		/* ECN-triggered (or marked this round): real congestion */
+		ssthresh = tp->snd_cwnd / CONGESTION_REDUCTION_FACTOR;
+		ENTE_TCP_INC_STATS(sk, ENTE_STAT_SSTHRESH_ECN);
+		
+	} else if (ente_tcp_loss_is_noise(ca)) {
+		/* High entropy (loss gaps, else RTT) = likely noise
+		 * (random loss)
+		 */
+		ssthresh = ente_tcp_noise_ssthresh(tp, ca, p);
+		ENTE_TCP_INC_STATS(sk, ENTE_STAT_SSTHRESH_NOISE);
+		
 	} else {
-		/* Not enough data: use standard reduction */
-		reduction_factor = CONGESTION_REDUCTION_FACTOR;
+		/* Low entropy = real congestion, medium entropy, or not
+		 * enough data: standard reduction, cwnd / 2
+		 */
+		ssthresh = tp->snd_cwnd / CONGESTION_REDUCTION_FACTOR;
+		ENTE_TCP_INC_STATS(sk, ENTE_STAT_SSTHRESH_CONGESTION);
 	}
 	
 	/* Calculate new ssthresh */
-	ca->ssthresh = max(tp->snd_cwnd / reduction_factor, 2U);
-	ca->prior_cwnd = tp->snd_cwnd;
+	/* The kernel saved the current cwnd in tp->prior_cwnd for undo */
+	ca->ssthresh = max(ssthresh, 2U);
+	
+	ente_tcp_prof_end(ENTE_PROF_SSTHRESH, prof);
+	return ca->ssthresh;
+}
+
+static u32 ente_tcp_ssthresh(struct sock *sk)
+{
+	return __ente_tcp_ssthresh(sk, &ente_tcp_profile_default);
+}
+
+/* L4S: scalable response, cwnd * (1 - alpha / 2)
+ * 
+ * CWR is entered at most once per round, so the reduction is proportional
+ * to the fraction of CE-marked packets in the last rounds rather than a
+ * fixed factor. Entropy plays no part here; it only shapes the increase.
+ * Losses are handled by ente_tcp_l4s_react_to_loss().
+ */
+static u32 ente_tcp_l4s_ssthresh(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct ente_tcp *ca = inet_csk_ca(sk);
+	
+	if (!(tp->ecn_flags & TCP_ECN_OK))
+		return ente_tcp_ssthresh(sk);
 	
+	ca->ssthresh = max(tp->snd_cwnd -
+			   ((tp->snd_cwnd * ca->ecn_alpha) >> 11U), 2U);
+	ENTE_TCP_INC_STATS(sk, ENTE_STAT_SSTHRESH_ECN);
 	return ca->ssthresh;
 }
 
-/* Undo cwnd reduction if loss was spurious (false alarm) */
+/* L4S: loss still gets a classic (Reno-equivalent) response, RFC 9331
+ * 
+ * The kernel has already called .ssthresh when entering Recovery or Loss,
+ * so override its result like DCTCP does.
+ */
+static void ente_tcp_l4s_react_to_loss(struct sock *sk)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct ente_tcp *ca = inet_csk_ca(sk);
+	
+	if (!(tp->ecn_flags & TCP_ECN_OK))
+		return;
+	
+	ca->loss_event = 1;
+	ente_tcp_count_loss(ca);
+	ca->ssthresh = max(tp->snd_cwnd / CONGESTION_REDUCTION_FACTOR, 2U);
+	tp->snd_ssthresh = ca->ssthresh;
+}
+
+/* Undo cwnd reduction if loss was spurious (false alarm)
+ * 
+ * Called once DSACKs, F-RTO or Eifel timestamps have shown that the
+ * retransmissions were unnecessary. Restores cwnd and our copy of
+ * ssthresh (tp->prior_ssthresh is the pre-loss value), forgets the loss
+ * and counts the undo towards the spurious-loss rate. tp->snd_ssthresh is
+ * left to tcp_undo_cwnd_reduction(), which restores it from prior_ssthresh
+ * and only then withdraws CWR.
+ */
 static u32 ente_tcp_undo_cwnd(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
 	struct ente_tcp *ca = inet_csk_ca(sk);
 	
-	/* Restore previous cwnd (loss was spurious) */
-	tp->snd_cwnd = max(tp->snd_cwnd, ca->prior_cwnd);
+	/* Restore previous cwnd and ssthresh (loss was spurious) */
+	tp->snd_cwnd = max(tp->snd_cwnd, tp->prior_cwnd);
+	ca->ssthresh = max(ca->ssthresh, tp->prior_ssthresh);
 	ca->in_slow_start = (tp->snd_cwnd < ca->ssthresh);
 	
-	return max(tp->snd_cwnd, ca->prior_cwnd);
+	ca->loss_event = 0;
+	if (ca->undo_events < ca->loss_episodes)
+		ca->undo_events++;
+	ENTE_TCP_INC_STATS(sk, ENTE_STAT_UNDOS);
+	
+	return max(tp->snd_cwnd, tp->prior_cwnd);
+}
+
+/* Idle restart: decay path knowledge instead of discarding it
+ * 
+ * Keeps the newest half of the RTT windows and the classification, but
+ * with one step less confidence. Only after CONFIDENCE_MAX idle periods
+ * without a fresh classification does the flow fall back to Reno.
+ */
+static void ente_tcp_idle_decay(struct ente_tcp *ca)
+{
+	ca->history_count >>= 1;
+	if (ca->ext)
+		ca->ext->history_count >>= 1;
+	ca->packets_acked = 0;
+	
+	if (ca->confidence)
+		ca->confidence--;
+	if (!ca->confidence)
+		ca->has_entropy_data = 0;
+}
+
+/* Transmission resumes with nothing in flight
+ * 
+ * Like cubic shifting its epoch: start a fresh round, and do not let an
+ * application-limited pause shorter than an RTO age the min_rtt filter.
+ * Longer pauses are left to age it (and trigger ente_tcp_idle_decay()).
+ */
+static void ente_tcp_tx_start(struct sock *sk, struct ente_tcp *ca)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	u32 now = tcp_jiffies32;
+	s32 delta = now - tp->lsndtime;
+	
+	ca->round_end_seq = tp->snd_nxt;
+	
+	if (delta > 0 && delta < inet_csk(sk)->icsk_rto) {
+		ca->min_rtt_stamp += delta;
+		if (time_after32(ca->min_rtt_stamp, now))
+			ca->min_rtt_stamp = now;
+	}
 }
 
 /* Handle congestion window events */
@@ -391,9 +2634,12 @@ static void ente_tcp_cwnd_event(struct sock *sk, enum tcp_ca_event ev)
 		break;
 		
 	case CA_EVENT_CWND_RESTART:
-		/* Connection restart after idle - reset state */
-		ca->history_count = 0;
-		ca->has_entropy_data = 0;
+		/* Connection restart after idle - decay state */
+		ente_tcp_idle_decay(ca);
+		break;
+		
+	case CA_EVENT_TX_START:
+		ente_tcp_tx_start(sk, ca);
 		break;
 		
 	default:
@@ -401,6 +2647,13 @@ static void ente_tcp_cwnd_event(struct sock *sk, enum tcp_ca_event ev)
 	}
 }
 
+static void ente_tcp_l4s_cwnd_event(struct sock *sk, enum tcp_ca_event ev)
+{
+	if (ev == CA_EVENT_LOSS)
+		ente_tcp_l4s_react_to_loss(sk);
+	ente_tcp_cwnd_event(sk, ev);
+}
+
 /* Provide diagnostic information */
 static size_t ente_tcp_get_info(struct sock *sk, u32 ext, int *attr,
 			         union tcp_cc_info *info)
@@ -419,23 +2672,98 @@ static size_t ente_tcp_get_info(struct sock *sk, u32 ext, int *attr,
 	return 0;
 }
 
+/* Was this fast recovery triggered by reordering rather than loss?
+ * 
+ * Needs positive evidence from the current episode: a SACK hole filled
+ * without retransmission (tp->reord_seen advanced) since the previous
+ * round boundary, or a DSACK since RACK last adjusted its window. A path
+ * that reordered at some point in the past is not enough, nor is a
+ * small lost_out, which is the normal case at recovery entry. The SACK
+ * hole must also be within the measured reordering degree. With no ECN
+ * marks this round, the reduction is then kept to the noise minimum;
+ * if the retransmits were indeed spurious, DSACKs undo even that.
+ */
+static bool ente_tcp_reordering(const struct sock *sk, struct ente_tcp *ca)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	u8 seen = (u8)tp->reord_seen;
+	bool reordered = seen != ca->reord_seen || tp->rack.dsack_seen;
+	
+	ca->reord_seen = seen;
+	
+	return READ_ONCE(reorder_tolerant) && reordered && !ca->ecn_ce_round &&
+	       tp->lost_out <= tp->reordering;
+}
+
 /* Set TCP state for congestion control */
 static void ente_tcp_set_state(struct sock *sk, u8 new_state)
 {
+	struct tcp_sock *tp = tcp_sk(sk);
 	struct ente_tcp *ca = inet_csk_ca(sk);
+	u8 old_state = inet_csk(sk)->icsk_ca_state;
 	
 	if (new_state == TCP_CA_Loss) {
 		/* Entering loss state */
 		ca->loss_event = 1;
 	}
+	
+	/* Entering Recovery, or Loss (RTO) from outside a recovery: the
+	 * episode is handled by the verdict ssthresh was just based on
+	 */
+	if ((new_state == TCP_CA_Recovery || new_state == TCP_CA_Loss) &&
+	    old_state < TCP_CA_Recovery) {
+		if (ca->ecn_ce_round)
+			ca->recovery_state = ENTE_STATE_CONGESTION;
+		else if (ente_tcp_loss_is_noise(ca))
+			ca->recovery_state = ENTE_STATE_NOISE;
+		else if (ca->has_entropy_data && ca->is_congestion)
+			ca->recovery_state = ENTE_STATE_CONGESTION;
+		else
+			ca->recovery_state = ENTE_STATE_NEUTRAL;
+	}
+	
+	/* Leaving CWR or (not undone) Recovery for Open or Disorder (a TLP
+	 * probe exits CWR through tcp_try_keep_open()): finish the PRR
+	 * reduction with cwnd = ssthresh, as tcp_end_cwnd_reduction() would
+	 */
+	if (new_state < TCP_CA_CWR &&
+	    tp->snd_ssthresh < TCP_INFINITE_SSTHRESH &&
+	    (old_state == TCP_CA_CWR ||
+	     (old_state == TCP_CA_Recovery && tp->undo_marker))) {
+		tp->snd_cwnd = tp->snd_ssthresh;
+		tp->snd_cwnd_stamp = tcp_jiffies32;
+	}
+	
+	/* Fresh fast recovery (.ssthresh was just called for it). Shared by
+	 * all profiles, so this rare path uses the default noise reduction.
+	 */
+	if (new_state == TCP_CA_Recovery && old_state < TCP_CA_CWR &&
+	    ente_tcp_reordering(sk, ca)) {
+		ca->ssthresh = max(ca->ssthresh,
+				   ente_tcp_noise_ssthresh(tp, ca,
+							   &ente_tcp_profile_default));
+		tp->snd_ssthresh = ca->ssthresh;
+		ENTE_TCP_INC_STATS(sk, ENTE_STAT_REORDER_RECOVERIES);
+	}
+}
+
+static void ente_tcp_l4s_set_state(struct sock *sk, u8 new_state)
+{
+	if (new_state == TCP_CA_Recovery &&
+	    new_state != inet_csk(sk)->icsk_ca_state)
+		ente_tcp_l4s_react_to_loss(sk);
+	ente_tcp_set_state(sk, new_state);
 }
 
 /* TCP congestion control operations structure */
 static struct tcp_congestion_ops ente_tcp_ops __read_mostly = {
 	.init		= ente_tcp_init,
+	.release	= ente_tcp_release,
 	.ssthresh	= ente_tcp_ssthresh,
-	.cong_avoid	= ente_tcp_cong_avoid,
+	.cong_control	= ente_tcp_cong_control,
 	.undo_cwnd	= ente_tcp_undo_cwnd,
+	.pkts_acked	= ente_tcp_pkts_acked,
+	.in_ack_event	= ente_tcp_in_ack_event,
 	.cwnd_event	= ente_tcp_cwnd_event,
 	.get_info	= ente_tcp_get_info,
 	.set_state	= ente_tcp_set_state,
@@ -443,31 +2771,499 @@ static struct tcp_congestion_ops ente_tcp_ops __read_mostly = {
 	.name		= "ente_tcp",
 };
 
+/* Model-based variant: cwnd = gain x BDP from delivery rate estimates */
+static struct tcp_congestion_ops ente_tcp_bdp_ops __read_mostly = {
+	.init		= ente_tcp_init,
+	.release	= ente_tcp_release,
+	.ssthresh	= ente_tcp_ssthresh,
+	.cong_control	= ente_tcp_bdp_cong_control,
+	.undo_cwnd	= ente_tcp_undo_cwnd,
+	.pkts_acked	= ente_tcp_pkts_acked,
+	.in_ack_event	= ente_tcp_in_ack_event,
+	.cwnd_event	= ente_tcp_cwnd_event,
+	.get_info	= ente_tcp_get_info,
+	.set_state	= ente_tcp_set_state,
+	.owner		= THIS_MODULE,
+	.name		= "ente_tcp_bdp",
+};
+
+/* L4S variant: ECT(1) marking and AccECN
+ * 
+ * Only registered where the kernel can send ECT(1). With ECT(0) the
+ * scalable response would meet classic RFC 3168 AQMs, which mark as if
+ * for a halving flow, and starve the classic flows sharing them.
+ */
+#ifdef TCP_CONG_WANTS_ECT_1
+#define ENTE_TCP_HAVE_L4S 1
+#define ENTE_TCP_L4S_FLAGS \
+	(TCP_CONG_NEEDS_ECN | TCP_CONG_NEEDS_ACCECN | TCP_CONG_WANTS_ECT_1)
+#else
+#define ENTE_TCP_HAVE_L4S 0
+#define ENTE_TCP_L4S_FLAGS TCP_CONG_NEEDS_ECN
+#endif
+
+static struct tcp_congestion_ops ente_tcp_l4s_ops __read_mostly __maybe_unused = {
+	.init		= ente_tcp_l4s_init,
+	.release	= ente_tcp_release,
+	.ssthresh	= ente_tcp_l4s_ssthresh,
+	.cong_control	= ente_tcp_l4s_cong_control,
+	.undo_cwnd	= ente_tcp_undo_cwnd,
+	.pkts_acked	= ente_tcp_pkts_acked,
+	.in_ack_event	= ente_tcp_in_ack_event,
+	.cwnd_event	= ente_tcp_l4s_cwnd_event,
+	.get_info	= ente_tcp_get_info,
+	.set_state	= ente_tcp_l4s_set_state,
+	.flags		= ENTE_TCP_L4S_FLAGS,
+	.owner		= THIS_MODULE,
+	.name		= "ente_tcp_l4s",
+};
+
+/* Tuning profiles: ente_tcp with other constants, selected per socket
+ * through TCP_CONGESTION like any other algorithm
+ */
+#define ENTE_TCP_PROFILE_OPS(_name)					\
+ENTE_CONG_CONTROL(ente_tcp_##_name##_cong_control)			\
+{									\
+	__ente_tcp_cong_control(sk, rs, &ente_tcp_profile_##_name);	\
+}									\
+									\
+static u32 ente_tcp_##_name##_ssthresh(struct sock *sk)		\
+{									\
+	return __ente_tcp_ssthresh(sk, &ente_tcp_profile_##_name);	\
+}									\
+									\
+static struct tcp_congestion_ops ente_tcp_##_name##_ops __read_mostly = { \
+	.init		= ente_tcp_init,				\
+	.release	= ente_tcp_release,				\
+	.ssthresh	= ente_tcp_##_name##_ssthresh,			\
+	.cong_control	= ente_tcp_##_name##_cong_control,		\
+	.undo_cwnd	= ente_tcp_undo_cwnd,				\
+	.pkts_acked	= ente_tcp_pkts_acked,				\
+	.in_ack_event	= ente_tcp_in_ack_event,			\
+	.cwnd_event	= ente_tcp_cwnd_event,				\
+	.get_info	= ente_tcp_get_info,				\
+	.set_state	= ente_tcp_set_state,				\
+	.owner		= THIS_MODULE,					\
+	.name		= "ente_tcp_" #_name,				\
+}
+
+ENTE_TCP_PROFILE_OPS(wifi);
+ENTE_TCP_PROFILE_OPS(cell);
+ENTE_TCP_PROFILE_OPS(sat);
+ENTE_TCP_PROFILE_OPS(dc);
+ENTE_TCP_PROFILE_OPS(w8);
+ENTE_TCP_PROFILE_OPS(w16);
+ENTE_TCP_PROFILE_OPS(w32);
+ENTE_TCP_PROFILE_OPS(w64);
+
+static struct tcp_congestion_ops *ente_tcp_variants[] = {
+	&ente_tcp_ops,
+	&ente_tcp_bdp_ops,
+#if ENTE_TCP_HAVE_L4S
+	&ente_tcp_l4s_ops,
+#endif
+	&ente_tcp_wifi_ops,
+	&ente_tcp_cell_ops,
+	&ente_tcp_sat_ops,
+	&ente_tcp_dc_ops,
+	&ente_tcp_w8_ops,
+	&ente_tcp_w16_ops,
+	&ente_tcp_w32_ops,
+	&ente_tcp_w64_ops,
+};
+
+/* debugfs ente_tcp/profile: per-site calls and cycles, folded over CPUs */
+static int ente_tcp_profile_show(struct seq_file *seq, void *v)
+{
+	static const u32 pct[] = { 50, 90, 99 };
+	const struct ente_tcp_prof *p;
+	u32 min, max, q[ARRAY_SIZE(pct)], i, b;
+	u64 count, sum, seen;
+	int site, cpu;
+	
+	seq_printf(seq, "%-20s %12s %8s %8s %8s %8s %8s %8s\n", "site", "calls",
+		   "min", "avg", "max", "p50", "p90", "p99");
+	
+	for (site = 0; site < ENTE_PROF_MAX; site++) {
+		count = 0;
+		sum = 0;
+		min = U32_MAX;
+		max = 0;
+		for_each_possible_cpu(cpu) {
+			p = per_cpu_ptr(ente_tcp_prof, cpu) + site;
+			if (!p->count)
+				continue;
+			count += p->count;
+			sum += p->sum;
+			min = min(min, p->min);
+			max = max(max, p->max);
+		}
+		
+		/* Percentiles: lower bound of the bucket that reaches them */
+		memset(q, 0, sizeof(q));
+		seen = 0;
+		for (b = 0, i = count ? 0 : ARRAY_SIZE(pct);
+		     b < PROF_BUCKETS && i < ARRAY_SIZE(pct); b++) {
+			for_each_possible_cpu(cpu) {
+				p = per_cpu_ptr(ente_tcp_prof, cpu) + site;
+				seen += p->hist[b];
+			}
+			while (i < ARRAY_SIZE(pct) && seen * 100 >= count * pct[i])
+				q[i++] = ente_tcp_hist_lower(b, PROF_SUB);
+		}
+		
+		seq_printf(seq, "%-20s %12llu %8u %8llu %8u %8u %8u %8u\n",
+			   ente_tcp_prof_names[site], count, count ? min : 0,
+			   count ? div64_u64(sum, count) : 0, max, q[0], q[1], q[2]);
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ente_tcp_profile);
+
+/* debugfs ente_tcp/enable: 1 clears the accumulators and starts, 0 stops */
+static ssize_t ente_tcp_prof_enable_write(struct file *file,
+					  const char __user *ubuf,
+					  size_t count, loff_t *ppos)
+{
+	bool enable;
+	int cpu, ret;
+	
+	ret = kstrtobool_from_user(ubuf, count, &enable);
+	if (ret)
+		return ret;
+	
+	if (enable) {
+		static_branch_disable(&ente_tcp_prof_key);
+		for_each_possible_cpu(cpu)
+			memset(per_cpu_ptr(ente_tcp_prof, cpu), 0,
+			       sizeof(struct ente_tcp_prof) * ENTE_PROF_MAX);
+		static_branch_enable(&ente_tcp_prof_key);
+	} else {
+		static_branch_disable(&ente_tcp_prof_key);
+	}
+	return count;
+}
+
+static ssize_t ente_tcp_prof_enable_read(struct file *file, char __user *ubuf,
+					 size_t count, loff_t *ppos)
+{
+	char buf[2] = { static_key_enabled(&ente_tcp_prof_key) ? '1' : '0', '\n' };
+	
+	return simple_read_from_buffer(ubuf, count, ppos, buf, sizeof(buf));
+}
+
+static const struct file_operations ente_tcp_prof_enable_fops = {
+	.owner	= THIS_MODULE,
+	.open	= simple_open,
+	.read	= ente_tcp_prof_enable_read,
+	.write	= ente_tcp_prof_enable_write,
+	.llseek	= default_llseek,
+};
+
+static struct dentry *ente_tcp_debugfs;
+
+/* Relay buffers appear as debugfs ente_tcp/trace<cpu> */
+static struct dentry *ente_tcp_trace_create_file(const char *filename,
+						 struct dentry *parent,
+						 umode_t mode,
+						 struct rchan_buf *buf,
+						 int *is_global)
+{
+	return debugfs_create_file(filename, mode, parent, buf,
+				   &relay_file_operations);
+}
+
+static int ente_tcp_trace_remove_file(struct dentry *dentry)
+{
+	debugfs_remove(dentry);
+	return 0;
+}
+
+static struct rchan_callbacks ente_tcp_trace_cb = {
+	.create_buf_file	= ente_tcp_trace_create_file,
+	.remove_buf_file	= ente_tcp_trace_remove_file,
+};
+
+/* debugfs ente_tcp/trace_enable: 1 starts tracing, 0 stops it. Records
+ * already buffered stay readable after stopping.
+ */
+static ssize_t ente_tcp_trace_enable_write(struct file *file,
+					   const char __user *ubuf,
+					   size_t count, loff_t *ppos)
+{
+	size_t subbuf;
+	bool enable;
+	int ret;
+	
+	ret = kstrtobool_from_user(ubuf, count, &enable);
+	if (ret)
+		return ret;
+	if (!IS_ENABLED(CONFIG_RELAY))
+		return -EOPNOTSUPP;
+	
+	mutex_lock(&ente_tcp_trace_lock);
+	if (enable && !ente_tcp_trace_chan) {
+		/* Whole records per sub-buffer: no padding to skip */
+		subbuf = rounddown(trace_subbuf_size,
+				   sizeof(struct ente_tcp_trace_rec));
+		ente_tcp_trace_chan = relay_open("trace", ente_tcp_debugfs,
+						 subbuf, trace_n_subbufs,
+						 &ente_tcp_trace_cb, NULL);
+		if (!ente_tcp_trace_chan) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+	
+	if (enable)
+		static_branch_enable(&ente_tcp_trace_key);
+	else
+		static_branch_disable(&ente_tcp_trace_key);
+	ret = count;
+out:
+	mutex_unlock(&ente_tcp_trace_lock);
+	return ret;
+}
+
+static ssize_t ente_tcp_trace_enable_read(struct file *file, char __user *ubuf,
+					  size_t count, loff_t *ppos)
+{
+	char buf[2] = { static_key_enabled(&ente_tcp_trace_key) ? '1' : '0', '\n' };
+	
+	return simple_read_from_buffer(ubuf, count, ppos, buf, sizeof(buf));
+}
+
+static const struct file_operations ente_tcp_trace_enable_fops = {
+	.owner	= THIS_MODULE,
+	.open	= simple_open,
+	.read	= ente_tcp_trace_enable_read,
+	.write	= ente_tcp_trace_enable_write,
+	.llseek	= default_llseek,
+};
+
+#ifdef CONFIG_PROC_FS
+/* /proc/net/ente_tcp: per-CPU counters folded for this netns */
+static int ente_tcp_stats_show(struct seq_file *seq, void *v)
+{
+	struct net *net = seq_file_single_net(seq);
+	struct ente_tcp_net *tn = net_generic(net, ente_tcp_net_id);
+	unsigned long sum;
+	int i, cpu;
+	
+	for (i = 0; i < ENTE_STAT_MAX; i++) {
+		sum = 0;
+		for_each_possible_cpu(cpu)
+			sum += per_cpu_ptr(tn->stats, cpu)->mibs[i];
+		seq_printf(seq, "%-20s %lu\n", ente_tcp_stat_names[i], sum);
+	}
+	return 0;
+}
+
+static void ente_tcp_hist_show_one(struct seq_file *seq, const char *name,
+				   u32 __percpu *counts, u32 buckets, u32 sub)
+{
+	u64 sum;
+	u32 b;
+	int cpu;
+	
+	for (b = 0; b < buckets; b++) {
+		sum = 0;
+		for_each_possible_cpu(cpu)
+			sum += *per_cpu_ptr(&counts[b], cpu);
+		if (sum)
+			seq_printf(seq, "%s %u %llu\n", name,
+				   ente_tcp_hist_lower(b, sub), sum);
+	}
+}
+
+/* /proc/net/ente_tcp_hist: "<name> <bucket lower bound> <count>" for each
+ * non-empty bucket; any write resets both histograms
+ */
+static int ente_tcp_hist_show(struct seq_file *seq, void *v)
+{
+	struct net *net = seq_file_single_net(seq);
+	struct ente_tcp_net *tn = net_generic(net, ente_tcp_net_id);
+	
+	ente_tcp_hist_show_one(seq, "entropy", tn->hist->entropy,
+			       HIST_BUCKETS(HIST_ENTROPY_BITS, HIST_ENTROPY_SUB),
+			       HIST_ENTROPY_SUB);
+	ente_tcp_hist_show_one(seq, "rtt_variance", tn->hist->variance,
+			       HIST_BUCKETS(HIST_VARIANCE_BITS, HIST_VARIANCE_SUB),
+			       HIST_VARIANCE_SUB);
+	return 0;
+}
+
+static int ente_tcp_hist_reset(struct file *file, char *buf, size_t size)
+{
+	struct seq_file *seq = file->private_data;
+	struct net *net = seq_file_single_net(seq);
+	struct ente_tcp_net *tn = net_generic(net, ente_tcp_net_id);
+	int cpu;
+	
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(tn->hist, cpu), 0, sizeof(struct ente_tcp_hist));
+	return 0;
+}
+#endif
+
+/* Per-netns setup and teardown of the warm-start cache and statistics */
+static int __net_init ente_tcp_net_init(struct net *net)
+{
+	struct ente_tcp_net *tn = net_generic(net, ente_tcp_net_id);
+	
+	spin_lock_init(&tn->cache_lock);
+	
+	tn->stats = alloc_percpu(struct ente_tcp_mib);
+	if (!tn->stats)
+		return -ENOMEM;
+	
+	tn->hist = alloc_percpu(struct ente_tcp_hist);
+	if (!tn->hist)
+		goto err_stats;
+	
+#ifdef CONFIG_PROC_FS
+	if (!proc_create_net_single("ente_tcp", 0444, net->proc_net,
+				    ente_tcp_stats_show, NULL))
+		goto err_hist;
+	
+	if (!proc_create_net_single_write("ente_tcp_hist", 0644, net->proc_net,
+					  ente_tcp_hist_show,
+					  ente_tcp_hist_reset, NULL)) {
+		remove_proc_entry("ente_tcp", net->proc_net);
+		goto err_hist;
+	}
+#endif
+	return 0;
+	
+#ifdef CONFIG_PROC_FS
+err_hist:
+	free_percpu(tn->hist);
+#endif
+err_stats:
+	free_percpu(tn->stats);
+	return -ENOMEM;
+}
+
+static void __net_exit ente_tcp_net_exit(struct net *net)
+{
+	struct ente_tcp_net *tn = net_generic(net, ente_tcp_net_id);
+	struct ente_tcp_cache_entry *e;
+	struct hlist_node *tmp;
+	u32 i;
+	
+	remove_proc_entry("ente_tcp_hist", net->proc_net);
+	remove_proc_entry("ente_tcp", net->proc_net);
+	
+	spin_lock_bh(&tn->cache_lock);
+	for (i = 0; i < ARRAY_SIZE(tn->cache); i++)
+		hlist_for_each_entry_safe(e, tmp, &tn->cache[i], node)
+			ente_tcp_cache_unlink(tn, e);
+	spin_unlock_bh(&tn->cache_lock);
+	
+	free_percpu(tn->hist);
+	free_percpu(tn->stats);
+}
+
+static struct pernet_operations ente_tcp_net_ops = {
+	.init	= ente_tcp_net_init,
+	.exit	= ente_tcp_net_exit,
+	.id	= &ente_tcp_net_id,
+	.size	= sizeof(struct ente_tcp_net),
+};
+
 /* Module initialization */
 static int __init ente_tcp_register(void)
 {
-	int ret;
+	int i, ret;
 	
 	/* Verify structure fits in kernel's allocated space */
 	BUILD_BUG_ON(sizeof(struct ente_tcp) > ICSK_CA_PRIV_SIZE);
 	
-	ret = tcp_register_congestion_control(&ente_tcp_ops);
+	/* Circular buffers are indexed with a mask */
+	BUILD_BUG_ON(ENTROPY_WINDOW_SIZE & (ENTROPY_WINDOW_SIZE - 1));
+	BUILD_BUG_ON(EXT_WINDOW_SIZE & (EXT_WINDOW_SIZE - 1));
+	BUILD_BUG_ON(LOSS_GAP_WINDOW & (LOSS_GAP_WINDOW - 1));
+	BUILD_BUG_ON((ENTROPY_WINDOW_SIZE << (EXT_SCALES - 1)) > EXT_WINDOW_SIZE);
+	
+	/* Trace records are a fixed on-disk format */
+	BUILD_BUG_ON(sizeof(struct ente_tcp_trace_rec) != 32);
+	
+	ente_tcp_ext_cachep = KMEM_CACHE(ente_tcp_ext, 0);
+	if (!ente_tcp_ext_cachep)
+		return -ENOMEM;
+	
+	ente_tcp_prof = __alloc_percpu(sizeof(struct ente_tcp_prof) * ENTE_PROF_MAX,
+				       __alignof__(struct ente_tcp_prof));
+	if (!ente_tcp_prof) {
+		ret = -ENOMEM;
+		goto err_cache;
+	}
+	
+	ente_tcp_cache_seed = get_random_u32();
+	ret = register_pernet_subsys(&ente_tcp_net_ops);
 	if (ret)
-		return ret;
+		goto err_prof;
+	
+	ret = genl_register_family(&ente_tcp_genl_family);
+	if (ret)
+		goto err_pernet;
+	
+	for (i = 0; i < ARRAY_SIZE(ente_tcp_variants); i++) {
+		ret = tcp_register_congestion_control(ente_tcp_variants[i]);
+		if (ret)
+			goto err_ops;
+	}
+	
+	/* Profiling and tracing are optional: debugfs errors are not fatal */
+	ente_tcp_debugfs = debugfs_create_dir("ente_tcp", NULL);
+	debugfs_create_file("enable", 0600, ente_tcp_debugfs, NULL,
+			    &ente_tcp_prof_enable_fops);
+	debugfs_create_file("profile", 0400, ente_tcp_debugfs, NULL,
+			    &ente_tcp_profile_fops);
+	debugfs_create_file("trace_enable", 0600, ente_tcp_debugfs, NULL,
+			    &ente_tcp_trace_enable_fops);
 	
 	pr_info("ENTE-TCP v%s: Entropy-Enhanced TCP Congestion Control registered\n",
 		ENTE_TCP_VERSION);
 	pr_info("ENTE-TCP: Distinguishes network noise from real congestion using entropy\n");
 	pr_info("ENTE-TCP: Structure size = %zu bytes (limit = %d bytes)\n",
 		sizeof(struct ente_tcp), ICSK_CA_PRIV_SIZE);
+	pr_info("ENTE-TCP: Extended state = %zu bytes per long-lived flow\n",
+		sizeof(struct ente_tcp_ext));
 	
 	return 0;
+	
+err_ops:
+	while (--i >= 0)
+		tcp_unregister_congestion_control(ente_tcp_variants[i]);
+	genl_unregister_family(&ente_tcp_genl_family);
+err_pernet:
+	unregister_pernet_subsys(&ente_tcp_net_ops);
+err_prof:
+	free_percpu(ente_tcp_prof);
+err_cache:
+	kmem_cache_destroy(ente_tcp_ext_cachep);
+	return ret;
 }
 
 /* Module cleanup */
 static void __exit ente_tcp_unregister(void)
 {
-	tcp_unregister_congestion_control(&ente_tcp_ops);
+	int i;
+	
+	/* The relay files live in the debugfs directory: close them first */
+	static_branch_disable(&ente_tcp_trace_key);
+	if (ente_tcp_trace_chan)
+		relay_close(ente_tcp_trace_chan);
+	debugfs_remove_recursive(ente_tcp_debugfs);
+	static_branch_disable(&ente_tcp_prof_key);
+	
+	for (i = ARRAY_SIZE(ente_tcp_variants) - 1; i >= 0; i--)
+		tcp_unregister_congestion_control(ente_tcp_variants[i]);
+	genl_unregister_family(&ente_tcp_genl_family);
+	unregister_pernet_subsys(&ente_tcp_net_ops);
+	free_percpu(ente_tcp_prof);
+	kmem_cache_destroy(ente_tcp_ext_cachep);
 	pr_info("ENTE-TCP: Unregistered from kernel\n");
 }
 
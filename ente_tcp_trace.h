@@ -0,0 +1,44 @@
+/*
+ * ENTE-TCP: Entropy-Enhanced TCP Congestion Control
+ * Per-ACK trace record format
+ *
+ * Shared by the kernel module, which writes one record per traced ACK into
+ * per-CPU relay buffers (debugfs ente_tcp/trace<cpu>), and by
+ * tools/ente_tcp_trace.c, which drains them into a trace file:
+ *
+ *   struct ente_tcp_trace_file_hdr, then struct ente_tcp_trace_rec * N
+ *
+ * All fields are in host byte order. Records from different CPUs are
+ * interleaved in the file; sort by tstamp_us to replay in order.
+ *
+ * Licensed under GPL v2
+ */
+
+#ifndef _ENTE_TCP_TRACE_H
+#define _ENTE_TCP_TRACE_H
+
+#include <linux/types.h>
+
+#define ENTE_TCP_TRACE_MAGIC 0x52545445U /* "ETTR" on little endian */
+#define ENTE_TCP_TRACE_VERSION 1
+
+struct ente_tcp_trace_file_hdr {
+	__u32 magic;                 /* ENTE_TCP_TRACE_MAGIC */
+	__u16 version;               /* ENTE_TCP_TRACE_VERSION */
+	__u16 rec_size;              /* sizeof(struct ente_tcp_trace_rec) */
+};
+
+struct ente_tcp_trace_rec {
+	__u64 tstamp_us;             /* tp->tcp_mstamp of the ACK */
+	__u32 flow_hash;             /* sk->sk_hash, stable for the flow */
+	__u32 rtt_us;                /* RTT sample of this ACK, 0 if none */
+	__u32 srtt_us;               /* Smoothed RTT */
+	__u32 cwnd;                  /* cwnd after this ACK */
+	__u16 acked;                 /* Packets newly acked or SACKed */
+	__u16 entropy;               /* Shannon entropy (0-1000) */
+	__u8 state;                  /* 0 neutral, 1 noise, 2 congestion */
+	__u8 ca_state;               /* TCP_CA_Open ... TCP_CA_Loss */
+	__u16 reserved;
+};
+
+#endif /* _ENTE_TCP_TRACE_H */
@@ -0,0 +1,190 @@
+/*
+ * ENTE-TCP: Entropy-Enhanced TCP Congestion Control
+ * Per-ACK trace reader
+ *
+ * Enables tracing, drains the per-CPU relay buffers in debugfs
+ * (ente_tcp/trace<cpu>) and writes a trace file: one
+ * struct ente_tcp_trace_file_hdr followed by fixed-size records, see
+ * ente_tcp_trace.h. Runs until SIGINT/SIGTERM or the -t duration ends,
+ * then stops tracing and drains what is left.
+ *
+ *   ente_tcp_trace [-d debugfs_dir] [-t seconds] <output file>
+ *
+ * Licensed under GPL v2
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../ente_tcp_trace.h"
+
+#define REC_SIZE sizeof(struct ente_tcp_trace_rec)
+#define READ_RECS 4096              /* Records per read() */
+#define POLL_MS 100
+
+struct cpu_buf {
+	int fd;
+	size_t len;                  /* Bytes of a partial record carried over */
+	char data[READ_RECS * REC_SIZE];
+};
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+	stop = 1;
+}
+
+static int set_enable(const char *dir, int on)
+{
+	char path[4096];
+	int fd, ret;
+	
+	snprintf(path, sizeof(path), "%s/trace_enable", dir);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	ret = write(fd, on ? "1" : "0", 1) == 1 ? 0 : -1;
+	close(fd);
+	return ret;
+}
+
+/* Read what one CPU has buffered and append the whole records to out */
+static long drain(struct cpu_buf *b, FILE *out)
+{
+	size_t whole;
+	ssize_t n;
+	long recs = 0;
+	
+	for (;;) {
+		n = read(b->fd, b->data + b->len, sizeof(b->data) - b->len);
+		if (n <= 0)
+			return n < 0 && errno != EAGAIN ? -1 : recs;
+		
+		b->len += n;
+		whole = b->len - b->len % REC_SIZE;
+		if (fwrite(b->data, 1, whole, out) != whole)
+			return -1;
+		recs += whole / REC_SIZE;
+		
+		b->len -= whole;
+		memmove(b->data, b->data + whole, b->len);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = "/sys/kernel/debug/ente_tcp";
+	struct ente_tcp_trace_file_hdr hdr = {
+		.magic = ENTE_TCP_TRACE_MAGIC,
+		.version = ENTE_TCP_TRACE_VERSION,
+		.rec_size = REC_SIZE,
+	};
+	struct cpu_buf *bufs;
+	struct pollfd *pfds;
+	char path[4096];
+	long ncpus, nfds = 0, total = 0, n;
+	time_t deadline = 0;
+	FILE *out;
+	int opt, i;
+	
+	while ((opt = getopt(argc, argv, "d:t:")) != -1) {
+		switch (opt) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 't':
+			deadline = time(NULL) + atol(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind != argc - 1)
+		goto usage;
+	
+	out = fopen(argv[optind], "wb");
+	if (!out || fwrite(&hdr, sizeof(hdr), 1, out) != 1) {
+		perror(argv[optind]);
+		return 1;
+	}
+	
+	/* The relay files only exist once tracing has been enabled */
+	if (set_enable(dir, 1)) {
+		fprintf(stderr, "cannot enable tracing in %s: %s\n", dir,
+			strerror(errno));
+		return 1;
+	}
+	
+	ncpus = sysconf(_SC_NPROCESSORS_CONF);
+	bufs = calloc(ncpus, sizeof(*bufs));
+	pfds = calloc(ncpus, sizeof(*pfds));
+	if (!bufs || !pfds) {
+		perror("calloc");
+		goto err;
+	}
+	
+	/* Offline CPUs have no buffer */
+	for (i = 0; i < ncpus; i++) {
+		snprintf(path, sizeof(path), "%s/trace%d", dir, i);
+		bufs[nfds].fd = open(path, O_RDONLY | O_NONBLOCK);
+		if (bufs[nfds].fd < 0)
+			continue;
+		pfds[nfds].fd = bufs[nfds].fd;
+		pfds[nfds].events = POLLIN;
+		nfds++;
+	}
+	if (!nfds) {
+		fprintf(stderr, "no trace buffers in %s\n", dir);
+		goto err;
+	}
+	
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	
+	while (!stop && (!deadline || time(NULL) < deadline)) {
+		if (poll(pfds, nfds, POLL_MS) < 0 && errno != EINTR)
+			break;
+		for (i = 0; i < nfds; i++) {
+			n = drain(&bufs[i], out);
+			if (n < 0)
+				goto err_io;
+			total += n;
+		}
+	}
+	
+	/* Stop, then collect the records written before the switch-off */
+	set_enable(dir, 0);
+	for (i = 0; i < nfds; i++) {
+		n = drain(&bufs[i], out);
+		if (n < 0)
+			goto err_io;
+		total += n;
+	}
+	
+	if (fclose(out)) {
+		perror(argv[optind]);
+		return 1;
+	}
+	fprintf(stderr, "%ld records from %ld CPUs written to %s\n",
+		total, nfds, argv[optind]);
+	return 0;
+	
+err_io:
+	perror("trace");
+err:
+	set_enable(dir, 0);
+	return 1;
+	
+usage:
+	fprintf(stderr, "usage: %s [-d debugfs_dir] [-t seconds] <output file>\n",
+		argv[0]);
+	return 2;
+}